@@ -0,0 +1,96 @@
+#pragma once
+
+#include "vk-wsi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Testing and diagnostics interface, only built into the library with the VKWSI_ENABLE_TESTING CMake option.
+
+// Simulated presentation engine, for reproducing compositor and driver pathologies deterministically. Sits between the
+// context it is passed to and the real driver (e.g. a headless surface). Events are scheduled against the
+// number of presents issued, see `src/vk-wsi-sim.cpp` for the scenario format.
+
+typedef struct vkwsi_simulator_stats
+{
+    uint64_t frames;
+
+    // Surface extent changes, and how long it took until a swapchain of the new extent was presented
+    uint32_t resizes;
+    uint32_t recovered_resizes;
+    uint64_t total_recovery_frames;
+    uint64_t max_recovery_frames;
+    uint64_t total_recovery_ns;
+    uint64_t max_recovery_ns;
+
+    uint32_t injected_out_of_date;
+    uint32_t injected_suboptimal;
+    uint32_t deadlocks;
+} vkwsi_simulator_stats;
+
+VkResult              vkwsi_simulator_create(vkwsi_simulator** sim, const char* scenario, vkwsi_log_callback log_callback);
+void                  vkwsi_simulator_destroy(vkwsi_simulator* sim);
+// Number of frames the scenario runs for, and the number of windows it expects to be driven with
+uint64_t              vkwsi_simulator_get_frame_count(vkwsi_simulator* sim);
+uint32_t              vkwsi_simulator_get_window_count(vkwsi_simulator* sim);
+// The window extent the application would be told about by its windowing toolkit
+VkExtent2D            vkwsi_simulator_get_window_extent(vkwsi_simulator* sim);
+vkwsi_simulator_stats vkwsi_simulator_get_stats(vkwsi_simulator* sim);
+
+// Adds a present completion at `time_ns` (see `vkwsi_present_prediction` for the time base) to the refresh estimation of
+// `swapchain`, as if waiting for a present had blocked until then. Checks the estimation against synthetic timestamps.
+void                  vkwsi_swapchain_add_timing_sample(vkwsi_swapchain* swapchain, uint64_t time_ns);
+
+// -----------------------------------------------------------------------------
+
+// Reader for recordings made with `vkwsi_context_info::record_path`. Swapchains are identified by the order in which
+// they were created. Driver records are tagged with the number of presents issued before them, matching the frame
+// numbering of simulator scenarios, so a recording can be replayed against `vkwsi_simulator`.
+
+typedef enum vkwsi_record_type
+{
+    vkwsi_record_type_swapchain_create,
+    vkwsi_record_type_swapchain_destroy,
+    vkwsi_record_type_swapchain_set_info,
+    vkwsi_record_type_swapchain_resize,
+    vkwsi_record_type_swapchain_acquire,
+    vkwsi_record_type_swapchain_present,
+    vkwsi_record_type_swapchain_release,
+
+    // Results returned by vkAcquireNextImageKHR / vkQueuePresentKHR, and changes in the surface's current extent
+    vkwsi_record_type_driver_acquire,
+    vkwsi_record_type_driver_present,
+    vkwsi_record_type_driver_surface_extent,
+} vkwsi_record_type;
+
+typedef struct vkwsi_record
+{
+    vkwsi_record_type type;
+
+    // Nanoseconds since the context was created
+    uint64_t time;
+    // Driver records only
+    uint64_t frame;
+
+    // Valid until the next call to `vkwsi_record_reader_next`
+    const uint32_t* swapchains;
+    uint32_t swapchain_count;
+
+    VkResult result;
+    vkwsi_swapchain_info info;
+    VkExtent2D extent;
+    bool host_wait;
+    uint32_t wait_count;
+} vkwsi_record;
+
+typedef struct vkwsi_record_reader vkwsi_record_reader;
+
+VkResult              vkwsi_record_reader_open(vkwsi_record_reader** reader, const char* path);
+void                  vkwsi_record_reader_close(vkwsi_record_reader* reader);
+// Returns VK_INCOMPLETE at the end of the recording
+VkResult              vkwsi_record_reader_next(vkwsi_record_reader* reader, vkwsi_record* record);
+
+#ifdef __cplusplus
+}
+#endif
@@ -29,6 +29,18 @@ typedef struct vkwsi_log_callback
     void* data;
 } vkwsi_log_callback;
 
+// Runs `job(job_data, i)` for every `i` in [0, count), in any order and on any threads, returning once all have completed
+typedef void(*vkwsi_job_fn)(void* job_data, uint32_t index);
+typedef void(*vkwsi_job_dispatch_fn)(void*, vkwsi_job_fn job, void* job_data, uint32_t count);
+
+typedef struct vkwsi_job_callback
+{
+    vkwsi_job_dispatch_fn fn;
+    void* data;
+} vkwsi_job_callback;
+
+typedef struct vkwsi_simulator vkwsi_simulator;
+
 typedef struct vkwsi_context_info
 {
     VkInstance instance;
@@ -36,6 +48,46 @@ typedef struct vkwsi_context_info
     VkPhysicalDevice physical_device;
     PFN_vkGetInstanceProcAddr get_instance_proc_addr;
 
+    // Device extensions enabled on `device`. Optional extensions the library can make use of are detected from these,
+    // and are otherwise ignored: `VK_KHR_incremental_present`, `VK_KHR_shared_presentable_image`,
+    // `VK_GOOGLE_display_timing`, and `VK_KHR_present_id` + `VK_KHR_present_wait` (only used together, with the
+    // `presentId` and `presentWait` features enabled).
+    const char* const* enabled_device_extensions;
+    uint32_t enabled_device_extension_count;
+
+    // Used for all Vulkan objects created by the library, and for the library's own objects (contexts, swapchains and
+    // their internal state). Log messages and library owned threads still use the global heap. Copied into the
+    // context. Null to use the global heap.
+    const VkAllocationCallbacks* allocation_callbacks;
+
+    // Timeout (in nanoseconds) for host waits in `vkwsi_swapchain_present`. 0 = wait indefinitely. Also bounds the
+    // vkWaitForPresentKHR used to time presents, which falls back to waiting on the present fence once it elapses.
+    uint64_t host_wait_timeout;
+
+    // Issue presents from a library owned thread. `vkwsi_swapchain_present` only enqueues the present and
+    // returns immediately, errors from the present thread are returned from a subsequent present call.
+    // The `queue` passed to `vkwsi_swapchain_present` is used from the present thread, and so must not be
+    // used concurrently by the application (use a dedicated queue for presentation).
+    bool async_present;
+
+    // Acquire from multiple swapchains in parallel. The per-swapchain work in `vkwsi_swapchain_acquire` (recreation,
+    // vkAcquireNextImageKHR, present fence waits and image view creation) is spread across `acquire_thread_count`
+    // threads (including the calling thread), or across the application's own job system if `acquire_job_callback`
+    // is set, so that acquire latency is bound by the slowest swapchain rather than the sum of all of them.
+    // 0 or 1 threads without a callback acquires serially. `log_callback` may then be called from any of these threads.
+    uint32_t acquire_thread_count;
+    vkwsi_job_callback acquire_job_callback;
+
+    // Route surface queries, acquires, presents and submissions through a simulated presentation engine
+    // (see `vkwsi_simulator_create` in vk-wsi-testing.h). A simulator may only be used by one context at a time.
+    // NOTE: Only available if the library was built with VKWSI_ENABLE_TESTING, context creation fails otherwise.
+    vkwsi_simulator* simulator;
+
+    // Record every public swapchain call, and the results the driver returned, to a compact binary file at this path
+    // (see `vkwsi_record_reader_open` in vk-wsi-testing.h). Null to disable recording.
+    // NOTE: Only available if the library was built with VKWSI_ENABLE_TESTING, context creation fails otherwise.
+    const char* record_path;
+
     vkwsi_log_callback log_callback;
 } vkwsi_context_info;
 
@@ -69,6 +121,19 @@ typedef struct vkwsi_swapchain_info
     VkCompositeAlphaFlagBitsKHR composite_alpha;
 
     VkPresentModeKHR present_mode;
+
+    // Image layout transitions performed by the library with prerecorded per-image command buffers. If `acquire_layout`
+    // is not UNDEFINED, acquired images are transitioned from UNDEFINED to it before `vkwsi_swapchain_acquire` signals.
+    // If `present_layout` is not UNDEFINED, images are transitioned from it to PRESENT_SRC_KHR before presenting.
+    // The command buffers are allocated for `queue_families[0]`, which must be the family of the acquire and present
+    // queues. Acquire fails with VK_ERROR_INITIALIZATION_FAILED if `queue_family_count` is 0.
+    VkImageLayout acquire_layout;
+    VkImageLayout present_layout;
+
+    // Grow the image count above `min_image_count` while acquires repeatedly stall, and shrink back when they stop,
+    // up to the surface's maxImageCount. Ignored for FIFO, FIFO_RELAXED and FIFO_LATEST_READY, which are throttled by
+    // blocking in acquire.
+    bool adaptive_image_count;
 } vkwsi_swapchain_info;
 
 vkwsi_swapchain_info vkwsi_swapchain_info_default();
@@ -82,9 +147,94 @@ typedef struct vkwsi_swapchain_image
     VkImageView view;
     VkExtent2D extent;
     uint64_t version;
+
+    // Retire counter values (see `vkwsi_swapchain_get_retired`). Resources used to render to this image can be reused
+    // once the counter reaches `retire_value`. `previous_retire_value` is the value at which this image's previous use
+    // finished (0 if it hasn't been presented before).
+    uint64_t retire_value;
+    uint64_t previous_retire_value;
+
+    // Created by `vkwsi_image_data_callbacks::create`, null if no callbacks are set
+    void* user_data;
+
+    // Feedback for this image's previous present: the ID it was given with `vkwsi_swapchain_set_present_timing`, and
+    // when it was actually shown (see `vkwsi_present_prediction` for the time base), 0 if unknown.
+    uint64_t previous_present_id;
+    uint64_t previous_present_time_ns;
 } vkwsi_swapchain_image;
 
+// Display timing estimated from when presents complete, see `vkwsi_swapchain_predict_next_present`. Times are in
+// nanoseconds on the `std::chrono::steady_clock` time base (CLOCK_MONOTONIC on Linux, QueryPerformanceCounter on Windows).
+typedef struct vkwsi_present_prediction
+{
+    uint64_t refresh_interval_ns;
+
+    // Next refresh after the time of the call
+    uint64_t next_refresh_ns;
+
+    // Refresh at which a present issued now would be shown, after the presents still outstanding
+    uint64_t next_present_ns;
+} vkwsi_present_prediction;
+
+// Timing for a single present, see `vkwsi_swapchain_set_present_timing`
+typedef struct vkwsi_present_timing
+{
+    // Reported back in `vkwsi_swapchain_image::previous_present_id`
+    uint64_t present_id;
+
+    // The present is not shown before this time (see `vkwsi_present_prediction` for the time base), but on the first
+    // refresh after it. Subtract half a refresh interval to aim for the nearest refresh instead. 0 = as soon as possible.
+    uint64_t desired_present_ns;
+} vkwsi_present_timing;
+
+// Per-image user data (command buffers, descriptor sets, etc.), created lazily the first time each image is acquired and
+// destroyed once the image's last present has completed, when the swapchain is recreated or destroyed. `create` may
+// be called from acquire worker threads (see `vkwsi_context_info::acquire_thread_count`), a failure is returned from
+// `vkwsi_swapchain_acquire`.
+typedef struct vkwsi_image_data_callbacks
+{
+    VkResult(*create)(void* data, vkwsi_swapchain* swapchain, const vkwsi_swapchain_image* image, void** user_data);
+    void(*destroy)(void* data, vkwsi_swapchain* swapchain, void* user_data);
+    void* data;
+} vkwsi_image_data_callbacks;
+
+// NOTE: If only `present_mode` changes in `vkwsi_swapchain_set_info`, and the new mode is compatible with the current
+//       swapchain (VK_EXT_surface_maintenance1), it takes effect from the next acquire without recreating the swapchain.
+
+// NOTE: Swapchains that are not presentable (zero extent / minimized, or repeatedly OUT-OF-DATE) are parked. Acquire
+//       skips parked swapchains and returns VK_TIMEOUT, `vkwsi_swapchain_get_current` returns a null image for them
+//       and present skips them. Parked swapchains are retried with exponential backoff, or immediately after a resize.
+//       Acquire never sleeps for parked swapchains, callers that have nothing else to do should wait for window events
+//       or until `vkwsi_swapchain_get_park_retry_time`. Swapchains skipped because they were marked unchanged
+//       (`vkwsi_swapchain_mark_unchanged`) are skipped the same way, but acquire returns VK_NOT_READY for them.
+//       VK_TIMEOUT takes precedence if both apply.
+
+// NOTE: Shared present modes (SHARED_DEMAND_REFRESH / SHARED_CONTINUOUS_REFRESH, requires
+//       `VK_KHR_shared_presentable_image`) use a single image that is acquired once after each swapchain (re)creation.
+//       Later acquires only poll vkGetSwapchainStatusKHR for OUT-OF-DATE, with no vkAcquireNextImageKHR call or acquire
+//       semaphore, and don't wait for the previous present (unless stale user data must be replaced). Presents then
+//       signal the presentation engine that the image was updated. Their `waits` are performed on the host rather than
+//       with a submission, unless a `vkwsi_swapchain_present_image` blit is presented along with them. The blit
+//       waits for the image's previous blit to complete first. The image stays in VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR,
+//       which the library transitions it to on its first acquire in place of `acquire_layout` / `present_layout`.
+//       `vkwsi_context_pick_present_mode` only picks shared modes if the extension is enabled.
+
+// NOTE: A context may be used concurrently from multiple threads, provided each swapchain is only used by one thread at a
+//       time and queues are externally synchronized as usual. Object pools and acquire timelines are kept per queue,
+//       so threads acquiring and presenting on their own queues never contend with each other.
+//
+//       `vkwsi_swapchain_resize` and `vkwsi_swapchain_set_info` are the exception, and may be called from any thread
+//       (e.g. directly from window event handlers) without locking. Updates are coalesced and take effect on the next
+//       `vkwsi_swapchain_acquire`.
+
+// NOTE: With `host_wait`, `waits` (which must all be timeline semaphores) are waited on by the calling thread
+//       and the swapchains are presented without any wait semaphores. Returns VK_TIMEOUT without presenting
+//       if `vkwsi_context_info::host_wait_timeout` elapses first.
+
 VkResult              vkwsi_swapchain_create(vkwsi_swapchain** swapchain, vkwsi_context* ctx, VkSurfaceKHR surface);
+// Creates a swapchain on a library owned VK_EXT_headless_surface surface (which must be enabled on the instance),
+// for running without a display server. The surface is destroyed with the swapchain.
+VkResult              vkwsi_swapchain_create_headless(vkwsi_swapchain** swapchain, vkwsi_context* ctx);
 void                  vkwsi_swapchain_destroy(vkwsi_swapchain* swapchain);
 void                  vkwsi_swapchain_set_info(vkwsi_swapchain* swapchain, const vkwsi_swapchain_info* info);
 VkResult              vkwsi_swapchain_resize(vkwsi_swapchain* swapchain, VkExtent2D extent);
@@ -92,6 +242,105 @@ VkResult              vkwsi_swapchain_acquire(vkwsi_swapchain* const* swapchains
 vkwsi_swapchain_image vkwsi_swapchain_get_current(vkwsi_swapchain* swapchain);
 VkResult              vkwsi_swapchain_present(vkwsi_swapchain* const* swapchains, uint32_t swapchain_count, VkQueue queue, const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait);
 
+// Presents each swapchain on its own queue, `queues[i]` for `swapchains[i]` (e.g. the queue that rendered to it).
+// Swapchains sharing a queue are presented together with a single vkQueuePresentKHR. `waits` are waited on once per
+// distinct queue, so must all be timeline semaphores if more than one queue is used. Waits on a value of 0 are taken to
+// be binary semaphores in that case, and fail the call with VK_ERROR_VALIDATION_FAILED_EXT.
+// Each queue's group is presented even if an earlier group failed, and the first failure is returned. If `results` is
+// not null, `results[i]` receives the result of the present that included `swapchains[i]`.
+VkResult              vkwsi_swapchain_present_queues(vkwsi_swapchain* const* swapchains, uint32_t swapchain_count, const VkQueue* queues, const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait, VkResult* results);
+
+typedef struct vkwsi_present_source
+{
+    // Must have been created with TRANSFER_SRC usage, and be in `layout` (TRANSFER_SRC_OPTIMAL or GENERAL) once `waits`
+    // have signalled.
+    VkImage image;
+    VkImageLayout layout;
+    VkExtent2D extent;
+
+    // Format the image was created with. Must support BLIT_SRC with optimal tiling.
+    VkFormat format;
+
+    // Used when the presentation engine can't scale the image and the swapchain extent differs from `extent`. Falls
+    // back to NEAREST if `format` doesn't support linear filtering.
+    VkFilter filter;
+} vkwsi_present_source;
+
+// Presents `sources[i]` to `swapchains[i]` instead of rendering into the acquired image. The acquired image (which
+// requires TRANSFER_DST usage) is filled with a blit recorded by the library, which is submitted together with
+// `waits` and is re-recorded only when a source changes. The blit is recorded for `queue_families[0]` as with
+// `acquire_layout`, and fails with VK_ERROR_INITIALIZATION_FAILED without it. Returns VK_ERROR_FORMAT_NOT_SUPPORTED if
+// the source format can't be blitted from, or the swapchain format can't be blitted to. Where the surface supports
+// stretching present scaling, the swapchain is created at the source extent and scaled by the presentation engine, so
+// that resizing the window does not recreate the swapchain. Sources are still presented through a 1:1 blit, as the
+// source image can't be presented directly.
+VkResult              vkwsi_swapchain_present_image(vkwsi_swapchain* const* swapchains, uint32_t swapchain_count, VkQueue queue, const vkwsi_present_source* sources, const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait);
+
+// Returns acquired images to the swapchain without presenting them (vkReleaseSwapchainImagesEXT). Any work the
+// application submitted that accesses the images must have completed first, the library waits for its own acquire
+// submission. The images must be re-acquired before presenting.
+VkResult              vkwsi_swapchain_release(vkwsi_swapchain* const* swapchains, uint32_t swapchain_count);
+
+// Blocks until at most `max_queued_frames` presents to `swapchain` are still outstanding (not yet retired by the
+// presentation engine). Call just before sampling input to bound motion-to-photon latency.
+VkResult              vkwsi_swapchain_wait_for_latency(vkwsi_swapchain* swapchain, uint32_t max_queued_frames);
+
+// Returns the swapchain's retire counter, which counts presents to `swapchain` in order and only ever increases. Every
+// present up to the returned value has been retired by the presentation engine, so anything used to render them may
+// be reused. Polls outstanding present fences.
+uint64_t              vkwsi_swapchain_get_retired(vkwsi_swapchain* swapchain);
+
+// Returns a timeline semaphore that mirrors the retire counter, created on first use and owned by the swapchain.
+// NOTE: The semaphore is signalled from the host whenever the library observes presents retiring (on acquire,
+//       `vkwsi_swapchain_wait_for_latency` and `vkwsi_swapchain_get_retired`). Device waits on it will only make
+//       progress while one of these keeps being called.
+VkResult              vkwsi_swapchain_get_retire_semaphore(vkwsi_swapchain* swapchain, VkSemaphore* semaphore);
+
+// Sets the callbacks for per-image user data, null to remove them. Existing user data is destroyed with the callbacks it
+// was created with once its image is no longer in use, without waiting: immediately for idle images, otherwise once the
+// image's present completes or the acquired image is released. The acquired image keeps its data until then.
+void                  vkwsi_swapchain_set_image_data_callbacks(vkwsi_swapchain* swapchain, const vkwsi_image_data_callbacks* callbacks);
+
+// Sets the regions of the acquired image that changed since it was last presented, in image coordinates. Passed to the
+// presentation engine with the next present through `VK_KHR_incremental_present` if it is enabled, and otherwise
+// ignored. Ignored if no image is acquired. Cleared by every acquire and present, a present without damage updates the
+// whole image.
+void                  vkwsi_swapchain_set_damage(vkwsi_swapchain* swapchain, const VkRectLayerKHR* rects, uint32_t rect_count);
+
+// Returns the time (steady clock, in nanoseconds) at which the next acquire retries a parked swapchain, or 0 if it is not
+// parked. Resizing the swapchain retries it immediately.
+uint64_t              vkwsi_swapchain_get_park_retry_time(vkwsi_swapchain* swapchain);
+
+// Marks the next frame of `swapchain` as unchanged. The next `vkwsi_swapchain_acquire` skips it like a parked swapchain
+// (no image, VK_NOT_READY) instead of acquiring an image just to present the same content again. An image is still
+// acquired if the swapchain needs recreating, or if the keep-alive interval has passed since it was last presented, and
+// must then be rendered in full. Acquire doesn't block for skipped swapchains, so the application should throttle
+// itself while idle (e.g. by waiting for window events).
+void                  vkwsi_swapchain_mark_unchanged(vkwsi_swapchain* swapchain);
+
+// Sets the interval (in nanoseconds) after which unchanged swapchains are presented again anyway, 0 = never
+void                  vkwsi_swapchain_set_keep_alive(vkwsi_swapchain* swapchain, uint64_t interval_ns);
+
+// Predicts when the next present of `swapchain` will be shown, to start a frame's CPU work just in time instead of as
+// early as possible. Returns VK_NOT_READY until enough presents have been timed.
+// NOTE: Presents are timed when the library blocks waiting for them to complete (on acquire, and in
+//       `vkwsi_swapchain_wait_for_latency`), with `vkWaitForPresentKHR` if enabled and otherwise on the present fence,
+//       which may signal some time before the image is actually shown. A present is only timed if the wait blocked for
+//       at least VKWSI_TIMING_MIN_WAIT_US (100us by default), as a present that had already completed could have done
+//       so at any point since it was issued. Applications that are never ahead of the display (e.g. always GPU bound)
+//       are therefore never timed. Only FIFO modes complete presents on a regular grid of refreshes, other present
+//       modes are not timed. If the application misses refreshes consistently, the estimated interval is a multiple
+//       of the display's. Estimation starts over when the swapchain is recreated or its present mode changes.
+VkResult              vkwsi_swapchain_predict_next_present(vkwsi_swapchain* swapchain, vkwsi_present_prediction* prediction);
+
+// Sets the timing of the next present to `swapchain`, cleared by every present. Desired present times are passed to the
+// presentation engine through `VK_GOOGLE_display_timing` if it is enabled. Otherwise the present is held back on the
+// host until just before the refresh it should be shown on (using the estimated refresh grid of FIFO swapchains, or
+// else until the desired time), but for no longer than VKWSI_MAX_PRESENT_HOLD_MS (100ms by default). This blocks
+// `vkwsi_swapchain_present`, unless `vkwsi_context_info::async_present` is set. Presents of multiple swapchains are held
+// until the latest of their desired times.
+void                  vkwsi_swapchain_set_present_timing(vkwsi_swapchain* swapchain, const vkwsi_present_timing* timing);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,11 @@
     /* Surface capabiltliies */                  \
     DO(GetPhysicalDeviceSurfaceCapabilities2KHR) \
     DO(GetPhysicalDeviceSurfacePresentModesKHR)  \
+    /* Formats */                                \
+    DO(GetPhysicalDeviceFormatProperties)        \
+    /* Surfaces */                               \
+    DO(CreateHeadlessSurfaceEXT)                 \
+    DO(DestroySurfaceKHR)                        \
 
 #define VKWSI_DEVICE_FUNCTIONS(DO)  \
 DO(SetDebugUtilsObjectNameEXT)  \
@@ -16,19 +21,33 @@ DO(SetDebugUtilsObjectNameEXT)  \
     DO(CreateSemaphore)             \
     DO(WaitSemaphores)              \
     DO(GetSemaphoreCounterValue)    \
+    DO(SignalSemaphore)             \
     DO(DestroySemaphore)            \
     /* Fences */                    \
     DO(CreateFence)                 \
     DO(ResetFences)                 \
     DO(WaitForFences)               \
+    DO(GetFenceStatus)              \
     DO(DestroyFence)                \
     /* Image views */               \
     DO(CreateImageView)             \
     DO(DestroyImageView)            \
+    /* Command buffers */           \
+    DO(CreateCommandPool)           \
+    DO(DestroyCommandPool)          \
+    DO(AllocateCommandBuffers)      \
+    DO(BeginCommandBuffer)          \
+    DO(EndCommandBuffer)            \
+    DO(CmdPipelineBarrier2)         \
+    DO(CmdBlitImage2)               \
     /* Swapchains */                \
     DO(CreateSwapchainKHR)          \
     DO(GetSwapchainImagesKHR)       \
     DO(AcquireNextImageKHR)         \
+    DO(ReleaseSwapchainImagesEXT)   \
+    DO(GetSwapchainStatusKHR)       \
+    DO(WaitForPresentKHR)           \
+    DO(GetPastPresentationTimingGOOGLE) \
     DO(DestroySwapchainKHR)         \
     /* Queue operations */          \
     DO(QueuePresentKHR)             \
@@ -1,17 +1,105 @@
 #pragma once
 
 #include "vk-wsi.h"
+#include "vk-wsi-testing.h"
 #include "vk-wsi-functions.hpp"
 
+#include <format>
+#include <new>
 #include <deque>
 #include <vector>
 #include <span>
 #include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
+// NOTE: Waits for every submission and present to complete before continuing. Not thread safe
 #ifndef VKWSI_DEBUG_LINEARIZE
 # define VKWSI_DEBUG_LINEARIZE 0
 #endif
 
+// Build in the simulator and call recorder (vk-wsi-testing.h), set by the VKWSI_ENABLE_TESTING CMake option
+#ifndef VKWSI_TESTING
+# define VKWSI_TESTING 0
+#endif
+
+#ifndef VKWSI_HOST_WAIT_BATCH_SIZE
+# define VKWSI_HOST_WAIT_BATCH_SIZE 16
+#endif
+
+#ifndef VKWSI_ASYNC_PRESENT_QUEUE_SIZE
+# define VKWSI_ASYNC_PRESENT_QUEUE_SIZE 8
+#endif
+
+// Maximum number of acquire semaphores waited on by a single acquire adapter submission
+#ifndef VKWSI_MAX_BINARY_WAITS
+# define VKWSI_MAX_BINARY_WAITS 2u
+#endif
+
+#ifndef VKWSI_MAX_QUEUES
+# define VKWSI_MAX_QUEUES 64
+#endif
+
+#ifndef VKWSI_OUT_OF_DATE_RETRY_LIMIT
+# define VKWSI_OUT_OF_DATE_RETRY_LIMIT 4
+#endif
+
+#ifndef VKWSI_PARK_BACKOFF_INITIAL_MS
+# define VKWSI_PARK_BACKOFF_INITIAL_MS 1
+#endif
+
+#ifndef VKWSI_PARK_BACKOFF_MAX_MS
+# define VKWSI_PARK_BACKOFF_MAX_MS 100
+#endif
+
+// Adaptive image count: a frame "stalls" if acquiring blocks for longer than the threshold. The swapchain grows by one
+// image if at least 1/GROW_DIVISOR of the frames in a window stall, and shrinks after SHRINK_WINDOWS stall-free windows.
+// Growth is bounded by the surface's maxImageCount, or by MAX_IMAGE_COUNT for surfaces without a limit.
+
+#ifndef VKWSI_ADAPTIVE_STALL_THRESHOLD_US
+# define VKWSI_ADAPTIVE_STALL_THRESHOLD_US 1000
+#endif
+
+#ifndef VKWSI_ADAPTIVE_WINDOW
+# define VKWSI_ADAPTIVE_WINDOW 64
+#endif
+
+#ifndef VKWSI_ADAPTIVE_GROW_DIVISOR
+# define VKWSI_ADAPTIVE_GROW_DIVISOR 4
+#endif
+
+#ifndef VKWSI_ADAPTIVE_SHRINK_WINDOWS
+# define VKWSI_ADAPTIVE_SHRINK_WINDOWS 8
+#endif
+
+#ifndef VKWSI_ADAPTIVE_MAX_IMAGE_COUNT
+# define VKWSI_ADAPTIVE_MAX_IMAGE_COUNT 8u
+#endif
+
+// Refresh estimation: present completions are timestamped when waiting for them blocked for at least MIN_WAIT. The
+// last SAMPLES timestamps are fit to a regular grid of refreshes once there are at least MIN_SAMPLES of them.
+
+#ifndef VKWSI_TIMING_MIN_WAIT_US
+# define VKWSI_TIMING_MIN_WAIT_US 100
+#endif
+
+#ifndef VKWSI_TIMING_SAMPLES
+# define VKWSI_TIMING_SAMPLES 32
+#endif
+
+#ifndef VKWSI_TIMING_MIN_SAMPLES
+# define VKWSI_TIMING_MIN_SAMPLES 8
+#endif
+
+// Longest a present is held on the host to honour its desired present time, see `vkwsi_swapchain_set_present_timing`
+
+#ifndef VKWSI_MAX_PRESENT_HOLD_MS
+# define VKWSI_MAX_PRESENT_HOLD_MS 100
+#endif
+
 #ifndef VKWSI_NOISY_SWAPCHAIN_CREATION
 # define VKWSI_NOISY_SWAPCHAIN_CREATION 0
 #endif
@@ -31,33 +119,357 @@ struct vkwsi_defer_guard
 
 #define defer vkwsi_defer_guard VKWSI_UNQIUE_VAR() = [&]
 
+// -----------------------------------------------------------------------------
+
+inline
+void vkwsi_log_(const vkwsi_log_callback& log_callback, vkwsi_log_level level, const char* message)
+{
+    log_callback.fn(log_callback.data, level, message);
+}
+
+template<typename ...Args>
+void vkwsi_log_(const vkwsi_log_callback& log_callback, vkwsi_log_level level, std::format_string<Args...> fmt, Args&&... args)
+{
+    log_callback.fn(log_callback.data, level, std::vformat(fmt.get(), std::make_format_args(args...)).c_str());
+}
+
+// NOTE: Usable with anything that has a `log_callback` member (contexts, simulators)
+#define VKWSI_LOG(ctx, level, fmt, ...) \
+    if ((ctx)->log_callback.fn) vkwsi_log_((ctx)->log_callback, level, fmt __VA_OPT__(,) __VA_ARGS__)
+
+constexpr bool operator==(VkExtent2D l, VkExtent2D r)
+{
+    return l.width == r.width && l.height == r.height;
+}
+
+#define VKWSI_CHECK(vkwsi_res) if (vkwsi_res != VK_SUCCESS) return res
+
+inline
+auto* vkwsi_temp(auto&& v)
+{
+    return &v;
+}
+
+// -----------------------------------------------------------------------------
+
+// NOTE: All library allocations are routed through the context's VkAllocationCallbacks when provided, falling back to
+//       the global heap otherwise. Containers carry the callbacks in their allocator, which propagates on assignment.
+
+inline
+void* vkwsi_allocate(const VkAllocationCallbacks* alloc, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (alloc) return alloc->pfnAllocation(alloc->pUserData, size, alignment, scope);
+    return ::operator new(size, std::align_val_t(alignment), std::nothrow);
+}
+
+inline
+void vkwsi_free(const VkAllocationCallbacks* alloc, void* ptr, size_t alignment)
+{
+    if (alloc) {
+        alloc->pfnFree(alloc->pUserData, ptr);
+    } else {
+        ::operator delete(ptr, std::align_val_t(alignment));
+    }
+}
+
+template<typename T>
+struct vkwsi_allocator
+{
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    const VkAllocationCallbacks* alloc = {};
+
+    vkwsi_allocator() = default;
+    vkwsi_allocator(const VkAllocationCallbacks* alloc): alloc(alloc) {}
+    template<typename U> vkwsi_allocator(const vkwsi_allocator<U>& other): alloc(other.alloc) {}
+
+    // NOTE: Throws std::bad_alloc on failure, as required by the standard containers. Public entry points that use
+    //       containers catch it and return VK_ERROR_OUT_OF_HOST_MEMORY, it must never propagate through the C API.
+    T* allocate(size_t n)
+    {
+        auto ptr = vkwsi_allocate(alloc, n * sizeof(T), alignof(T), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+        if (!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t)
+    {
+        vkwsi_free(alloc, ptr, alignof(T));
+    }
+
+    template<typename U>
+    bool operator==(const vkwsi_allocator<U>& other) const { return alloc == other.alloc; }
+};
+
+template<typename T>
+using vkwsi_vector = std::vector<T, vkwsi_allocator<T>>;
+
+template<typename T>
+using vkwsi_deque = std::deque<T, vkwsi_allocator<T>>;
+
+template<typename K, typename V>
+using vkwsi_unordered_map = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, vkwsi_allocator<std::pair<const K, V>>>;
+
+template<typename T, typename ...Args>
+T* vkwsi_new(const VkAllocationCallbacks* alloc, VkSystemAllocationScope scope, Args&&... args)
+{
+    auto ptr = vkwsi_allocate(alloc, sizeof(T), alignof(T), scope);
+    if (!ptr) return nullptr;
+    try {
+        return new (ptr) T(std::forward<Args>(args)...);
+    } catch (const std::bad_alloc&) {
+        vkwsi_free(alloc, ptr, alignof(T));
+        return nullptr;
+    }
+}
+
+template<typename T>
+void vkwsi_delete(const VkAllocationCallbacks* alloc, T* ptr)
+{
+    if (!ptr) return;
+    ptr->~T();
+    vkwsi_free(alloc, ptr, alignof(T));
+}
+
+// -----------------------------------------------------------------------------
+
+// Bounded lock-free multi-producer / single-consumer queue (Vyukov). Producers block while full,
+// the consumer blocks while empty. Values are constructed once and reused in place.
+template<typename T, uint32_t Capacity>
+struct vkwsi_mpsc_queue
+{
+    struct slot
+    {
+        std::atomic<uint64_t> sequence;
+        uint64_t position;
+        T value;
+    };
+
+    slot slots[Capacity];
+    alignas(64) std::atomic<uint64_t> push_position = 0;
+    alignas(64) uint64_t pop_position = 0;
+
+    vkwsi_mpsc_queue(const T& value = {})
+    {
+        for (uint32_t i = 0; i < Capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+            slots[i].value = value;
+        }
+    }
+
+    slot& begin_push()
+    {
+        uint64_t pos = push_position.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& s = slots[pos % Capacity];
+            uint64_t seq = s.sequence.load(std::memory_order_acquire);
+            auto diff = int64_t(seq - pos);
+            if (diff == 0) {
+                if (push_position.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.position = pos;
+                    return s;
+                }
+            } else if (diff < 0) {
+                // Full, wait for the consumer to release this slot
+                s.sequence.wait(seq, std::memory_order_acquire);
+                pos = push_position.load(std::memory_order_relaxed);
+            } else {
+                pos = push_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void end_push(slot& s)
+    {
+        s.sequence.store(s.position + 1, std::memory_order_release);
+        s.sequence.notify_all();
+    }
+
+    T& front()
+    {
+        auto& s = slots[pop_position % Capacity];
+        for (;;) {
+            uint64_t seq = s.sequence.load(std::memory_order_acquire);
+            if (seq == pop_position + 1) return s.value;
+            s.sequence.wait(seq, std::memory_order_acquire);
+        }
+    }
+
+    void pop()
+    {
+        auto& s = slots[pop_position % Capacity];
+        s.sequence.store(pop_position + Capacity, std::memory_order_release);
+        s.sequence.notify_all();
+        pop_position++;
+    }
+};
+
+// -----------------------------------------------------------------------------
+
+struct vkwsi_swapchain;
+struct vkwsi_recorder;
+
+struct vkwsi_present_request
+{
+    VkQueue queue;
+    bool host_wait;
+    bool stop;
+    VkSemaphore binary_semaphore;
+
+    // The first `user_wait_count` waits are those given to present, and are the only ones performed on the host with
+    // `host_wait`. They are followed by the acquire waits of any blits in `cmds`, which are always performed on the queue.
+    vkwsi_vector<VkSemaphoreSubmitInfo> waits;
+    uint32_t user_wait_count;
+    vkwsi_vector<VkCommandBufferSubmitInfo> cmds;
+    vkwsi_vector<vkwsi_swapchain*> swapchains;
+    vkwsi_vector<VkSwapchainKHR> vk_swapchains;
+    vkwsi_vector<uint32_t> indices;
+    vkwsi_vector<VkPresentModeKHR> present_modes;
+    vkwsi_vector<VkFence> fences;
+    vkwsi_vector<VkResult> results;
+
+    // Present IDs (VK_KHR_present_id), empty unless present waits are enabled
+    vkwsi_vector<uint64_t> present_ids;
+
+    // Desired present times (VK_GOOGLE_display_timing), empty unless display timing is enabled. Without it, presents with
+    // a desired present time are instead held on the host until `hold_until`.
+    vkwsi_vector<VkPresentTimeGOOGLE> present_times;
+    std::chrono::steady_clock::time_point hold_until;
+
+    // Per-swapchain damage (VK_KHR_incremental_present), empty if no swapchain has any. `regions` point into `rects`
+    vkwsi_vector<VkPresentRegionKHR> regions;
+    vkwsi_vector<VkRectLayerKHR> rects;
+
+    vkwsi_present_request(const VkAllocationCallbacks* alloc = {})
+        : waits(alloc), cmds(alloc), swapchains(alloc), vk_swapchains(alloc), indices(alloc)
+        , present_modes(alloc), fences(alloc), results(alloc), present_ids(alloc), present_times(alloc)
+        , regions(alloc), rects(alloc)
+    {}
+};
+
 struct vkwsi_acquire_resources
 {
     uint64_t timeline_value;
-    std::vector<VkSemaphore> semaphores;
+    vkwsi_vector<VkSemaphore> semaphores;
+};
+
+struct vkwsi_queue_state;
+
+// Binary semaphore waited on by a present. Released once every swapchain in the present has completed, which may
+// happen on any thread, so completed semaphores are pushed back to their owning queue state lock-free.
+struct vkwsi_present_semaphore
+{
+    VkSemaphore semaphore;
+    vkwsi_queue_state* owner;
+    std::atomic<uint32_t> pending;
+    vkwsi_present_semaphore* next;
 };
 
+// NOTE: Vulkan requires queue operations to be externally synchronized, so state keyed on a queue is only ever used by
+//       one thread at a time and needs no locking. This gives each render thread its own object pools, and its own
+//       timeline, as signal operations are only ordered within a single queue.
+struct vkwsi_queue_state
+{
+    VkQueue queue = {};
+
+    VkSemaphore timeline = {};
+    uint64_t timeline_value = 0;
+
+    vkwsi_vector<VkSemaphore> binary_semaphores;
+    vkwsi_deque<vkwsi_acquire_resources> acquire_resource_release_queue;
+
+    // All present semaphores owned by this queue, free for reuse, and released from other threads
+    vkwsi_vector<vkwsi_present_semaphore*> present_semaphores;
+    vkwsi_present_semaphore* free_present_semaphores = {};
+    std::atomic<vkwsi_present_semaphore*> released_present_semaphores = {};
+
+    // Reused for synchronous presents
+    vkwsi_present_request present_request;
+
+    // NOTE: In async mode the present queue is only used by the present thread, and so presents to it may be prepared
+    //       concurrently from multiple threads.
+    std::mutex async_mutex;
+
+    vkwsi_queue_state(const VkAllocationCallbacks* alloc)
+        : binary_semaphores(alloc), acquire_resource_release_queue(alloc)
+        , present_semaphores(alloc), present_request(alloc)
+    {}
+};
+
+// -----------------------------------------------------------------------------
+
+// Fixed set of threads that run `vkwsi_job_fn` batches alongside the dispatching thread. Only one batch runs at a time,
+// dispatches that find the pool busy run their jobs inline instead of waiting.
+struct vkwsi_worker_pool
+{
+    vkwsi_worker_pool(const VkAllocationCallbacks* alloc): threads(alloc) {}
+
+    vkwsi_vector<std::thread> threads;
+
+    std::mutex dispatch_mutex;
+
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    uint64_t generation = 0;
+    uint32_t active = 0;
+    bool stop = false;
+
+    vkwsi_job_fn job = {};
+    void* job_data = {};
+    uint32_t job_count = 0;
+    std::atomic<uint32_t> next_job = 0;
+};
+
+// -----------------------------------------------------------------------------
+
 struct vkwsi_context : vkwsi_functions
 {
+    vkwsi_context(const VkAllocationCallbacks* _alloc)
+        : vkwsi_functions {}
+        , alloc_callbacks(_alloc ? *_alloc : VkAllocationCallbacks {})
+        , alloc(_alloc ? &alloc_callbacks : nullptr)
+    {}
+
     VkInstance instance = {};
     VkDevice device = {};
-    VkPhysicalDevice physical_device;
-    const VkAllocationCallbacks* alloc = {};
+    VkPhysicalDevice physical_device = {};
+
+    // Copy of the user's callbacks, null if not provided
+    VkAllocationCallbacks alloc_callbacks;
+    const VkAllocationCallbacks* alloc;
 
     vkwsi_log_callback log_callback = {};
 
+    uint64_t host_wait_timeout = UINT64_MAX;
+
+    // Optional device extensions, see `vkwsi_context_info::enabled_device_extensions`
+    bool incremental_present = false;
+    bool shared_presentable_image = false;
+    bool present_wait = false;
+    bool display_timing = false;
+
 #if VKWSI_DEBUG_LINEARIZE
     VkFence debug_fence = {};
 #endif
 
-    VkSemaphore timeline = {};
-    uint64_t timeline_value = 0;
+    // Looked up lock-free, entries are only removed when the context is destroyed
+    std::atomic<vkwsi_queue_state*> queue_states[VKWSI_MAX_QUEUES] = {};
+
+    bool async_present = false;
+    vkwsi_mpsc_queue<vkwsi_present_request, VKWSI_ASYNC_PRESENT_QUEUE_SIZE> present_queue { vkwsi_present_request(alloc) };
+    std::thread present_thread;
+    std::atomic<VkResult> async_present_result = VK_SUCCESS;
 
-    std::vector<VkFence> fences;
-    std::vector<VkSemaphore> binary_semaphores;
+    // Parallel acquire, see `vkwsi_context_info::acquire_thread_count`
+    vkwsi_job_callback acquire_job_callback = {};
+    vkwsi_worker_pool* acquire_workers = {};
 
-    std::deque<vkwsi_acquire_resources> acquire_resource_release_queue;
-    std::unordered_map<VkSemaphore, uint32_t> present_semaphore_release_map;
+    vkwsi_simulator* simulator = {};
+    vkwsi_recorder* recorder = {};
 };
 
 struct vkwsi_swapchain_per_image_resources
@@ -65,23 +477,257 @@ struct vkwsi_swapchain_per_image_resources
     VkImage image;
     VkImageView view;
     VkFence present_signal_fence;
-    VkSemaphore last_present_wait_semaphore;
+    vkwsi_present_semaphore* present_wait_semaphore;
+    uint64_t present_serial;
+
+    // Per-image user data, destroyed with the callbacks it was created with. `user_data_stale` is set once those
+    // callbacks have been replaced, the data is then destroyed as soon as the image is no longer in use.
+    void* user_data;
+    vkwsi_image_data_callbacks user_data_callbacks;
+    bool user_data_stale;
+
+    // Prerecorded layout transitions, see `vkwsi_swapchain_info::acquire_layout`
+    VkCommandBuffer acquire_cmd;
+    VkCommandBuffer present_cmd;
+
+    // Blit from the last source presented to this image, see `vkwsi_swapchain_present_image`. `blit_serial` is the
+    // present serial of the last present that submitted it.
+    VkCommandBuffer blit_cmd;
+    vkwsi_present_source blit_source;
+    uint64_t blit_serial;
+
+    // Present timing feedback for the last present of this image, see `vkwsi_swapchain_set_present_timing`
+    uint64_t present_id;
+    std::chrono::steady_clock::time_point present_time;
+};
+
+// A swapchain replaced by recreation. Its images may still be queued for presentation, so it is destroyed along with
+// its per-image resources once all of its present fences have signalled, instead of waiting for them on recreation.
+struct vkwsi_retired_swapchain
+{
+    VkSwapchainKHR swapchain;
+    VkCommandPool transition_pool;
+    vkwsi_vector<vkwsi_swapchain_per_image_resources> resources;
+};
+
+// An earlier present of a shared presentable image, which is presented again without waiting for its previous present.
+// Kept until its fence has signalled, see `vkwsi_collect_shared_presents`.
+struct vkwsi_shared_present
+{
+    VkFence fence;
+    vkwsi_present_semaphore* semaphore;
+    uint64_t serial;
 };
 
 struct vkwsi_swapchain
 {
-    vkwsi_context* ctx = {};
+    vkwsi_swapchain(vkwsi_context* _ctx): ctx(_ctx) {}
+
+    vkwsi_context* ctx;
     VkSurfaceKHR surface = {};
+    bool owns_surface = false;
     VkSwapchainKHR swapchain = {};
     VkExtent2D last_extent = {};
     VkExtent2D pending_extent = {};
 
-    std::vector<vkwsi_swapchain_per_image_resources> resources;
+    vkwsi_vector<vkwsi_swapchain_per_image_resources> resources { ctx->alloc };
+
+    // Present fences are only ever used by the swapchain they were created for, so the pool needs no synchronization
+    vkwsi_vector<VkFence> fences { ctx->alloc };
     uint32_t image_index;
+    bool acquired = false;
+
+    // Queue timeline value signalled once the acquire submission for the acquired image has completed, which waits on
+    // the image and runs its `acquire_cmd`. See `vkwsi_acquire`.
+    VkSemaphore acquire_timeline = {};
+    uint64_t acquire_timeline_value = 0;
+
+    // Pool for the per-image transition and blit command buffers, recreated with the swapchain
+    VkCommandPool transition_pool = {};
+
+    // Previous swapchains with presents still outstanding, oldest first. Polled on acquire.
+    vkwsi_vector<vkwsi_retired_swapchain> retired_swapchains { ctx->alloc };
 
-    bool out_of_date = true;
+    // Set by `vkwsi_swapchain_present_image` for the next present, which submits the image's `blit_cmd` in place of
+    // its `present_cmd`.
+    bool present_from_source = false;
+
+    // Extent of the last presented source. If `source_scaled`, the swapchain was created at this extent with stretching
+    // present scaling, and changes to the window extent don't require recreation.
+    VkExtent2D source_extent = {};
+    bool source_scaled = false;
+    bool source_scaling_supported = false;
+
+    // Present modes the current swapchain was created with, `info.present_mode` can be switched between these freely
+    vkwsi_vector<VkPresentModeKHR> compatible_present_modes { ctx->alloc };
+
+    // Incremented for every present, used to order outstanding presents
+    uint64_t present_serial = 0;
+
+    // Every present up to and including this serial has retired, see `vkwsi_swapchain_get_retired`. Mirrored into
+    // `retire_timeline` once it has been requested by the user.
+    uint64_t retired_serial = 0;
+    VkSemaphore retire_timeline = {};
+
+    // Number of images that may already be acquired when calling vkAcquireNextImageKHR with an infinite timeout
+    uint32_t acquire_headroom = 0;
+
+    // Async present state. `vk_mutex` provides host synchronization for `swapchain` between
+    // vkAcquireNextImageKHR and vkQueuePresentKHR on the present thread.
+    std::mutex vk_mutex;
+    std::atomic<uint32_t> queued_presents = 0;
+
+    // Adaptive image count state, see `vkwsi_swapchain_info::adaptive_image_count`
+    uint32_t max_image_count = 0;
+    uint32_t adaptive_extra_images = 0;
+    struct {
+        uint32_t frames;
+        uint32_t stalls;
+        uint32_t idle_windows;
+    } adaptive_stats = {};
+
+    // Swapchains that can't currently be presented to (zero extent, persistently OUT-OF-DATE) are skipped by acquire
+    // until `park_retry_time`, with exponential backoff between attempts.
+    bool parked = false;
+    std::chrono::nanoseconds park_backoff = {};
+    std::chrono::steady_clock::time_point park_retry_time = {};
+
+    std::atomic<bool> out_of_date = true;
     uint64_t version = 0;
 
+    // Identifies this swapchain in recordings
+    uint32_t record_id = 0;
+
     vkwsi_swapchain_info info = {};
     vkwsi_swapchain_info pending_info = {};
+
+    // Info the current swapchain was created from, before image count adjustments and present mode switches
+    vkwsi_swapchain_info created_info = {};
+
+    vkwsi_image_data_callbacks image_data_callbacks = {};
+
+    // Damage for the next present, see `vkwsi_swapchain_set_damage`
+    vkwsi_vector<VkRectLayerKHR> damage { ctx->alloc };
+
+    // Set once the image of a swapchain with a shared present mode has been acquired, it then stays acquired until the
+    // swapchain is recreated.
+    bool shared_acquired = false;
+
+    // Outstanding presents of the shared image that have been superseded by a later present, oldest first
+    vkwsi_vector<vkwsi_shared_present> shared_presents { ctx->alloc };
+
+    // Idle state, see `vkwsi_swapchain_mark_unchanged`
+    bool unchanged = false;
+    std::chrono::nanoseconds keep_alive = {};
+    std::chrono::steady_clock::time_point last_present_time = {};
+
+    // Refresh estimation, see `vkwsi_swapchain_predict_next_present`. `samples` is a ring of present completion times,
+    // `refresh_phase` is the time of a refresh on the fitted grid (zero `refresh_interval` until there is a fit).
+    struct {
+        std::chrono::steady_clock::time_point samples[VKWSI_TIMING_SAMPLES];
+        uint32_t head;
+        uint32_t count;
+        std::chrono::nanoseconds refresh_interval;
+        std::chrono::steady_clock::time_point refresh_phase;
+    } timing = {};
+
+    // Timing for the next present, see `vkwsi_swapchain_set_present_timing`
+    vkwsi_present_timing present_timing = {};
+
+    // Reused for reading back VK_GOOGLE_display_timing feedback
+    vkwsi_vector<VkPastPresentationTimingGOOGLE> past_timings { ctx->alloc };
+
+    // Mailbox for `vkwsi_swapchain_resize` and `vkwsi_swapchain_set_info`, which may be called from any thread.
+    // Updates overwrite each other until acquire (on the thread using the swapchain) consumes the latest one.
+    // The extent is packed as (width << 32 | height), the info is owned by whoever takes it out of the mailbox.
+    std::atomic<uint64_t> mailbox_extent = 0;
+    std::atomic<vkwsi_swapchain_info*> mailbox_info = nullptr;
 };
+
+// -----------------------------------------------------------------------------
+
+#if VKWSI_TESTING
+
+// Simulated presentation functions (vk-wsi-sim.cpp), called in place of the driver's while `ctx->simulator` is set
+VkResult vkwsi_sim_get_surface_capabilities(vkwsi_context* ctx, const VkPhysicalDeviceSurfaceInfo2KHR* info, VkSurfaceCapabilities2KHR* caps);
+VkResult vkwsi_sim_create_swapchain(vkwsi_context* ctx, const VkSwapchainCreateInfoKHR* info, VkSwapchainKHR* swapchain);
+VkResult vkwsi_sim_acquire_next_image(vkwsi_context* ctx, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore, VkFence fence, uint32_t* index);
+VkResult vkwsi_sim_queue_submit2(vkwsi_context* ctx, VkQueue queue, uint32_t submit_count, const VkSubmitInfo2* submits, VkFence fence);
+VkResult vkwsi_sim_queue_present(vkwsi_context* ctx, VkQueue queue, const VkPresentInfoKHR* info);
+
+// Call recording (vk-wsi-record.cpp). Only called when `ctx->recorder` is set
+VkResult vkwsi_recorder_create(vkwsi_recorder** recorder, const char* path, const VkAllocationCallbacks* alloc);
+void vkwsi_recorder_destroy(vkwsi_recorder* recorder, const VkAllocationCallbacks* alloc);
+// `payload` is the vkwsi_swapchain_info for set_info, or the VkExtent2D for resize
+void vkwsi_record_swapchain(vkwsi_swapchain* swapchain, vkwsi_record_type type, const void* payload = nullptr);
+void vkwsi_record_swapchains(
+    vkwsi_context* ctx, vkwsi_record_type type, std::chrono::steady_clock::time_point time,
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkResult result, bool host_wait = false, uint32_t wait_count = 0);
+void vkwsi_record_driver_acquire(vkwsi_swapchain* swapchain, VkResult result);
+void vkwsi_record_driver_present(vkwsi_context* ctx, const vkwsi_present_request& request);
+void vkwsi_record_driver_surface_extent(vkwsi_swapchain* swapchain, VkExtent2D extent);
+
+#else
+
+// NOTE: `ctx->recorder` is never set without VKWSI_TESTING, these are never called
+inline void vkwsi_recorder_destroy(vkwsi_recorder*, const VkAllocationCallbacks*) {}
+inline void vkwsi_record_swapchain(vkwsi_swapchain*, vkwsi_record_type, const void* = nullptr) {}
+inline void vkwsi_record_swapchains(
+    vkwsi_context*, vkwsi_record_type, std::chrono::steady_clock::time_point,
+    vkwsi_swapchain* const*, uint32_t,
+    VkResult, bool = false, uint32_t = 0) {}
+inline void vkwsi_record_driver_acquire(vkwsi_swapchain*, VkResult) {}
+inline void vkwsi_record_driver_present(vkwsi_context*, const vkwsi_present_request&) {}
+inline void vkwsi_record_driver_surface_extent(vkwsi_swapchain*, VkExtent2D) {}
+
+#endif
+
+// -----------------------------------------------------------------------------
+
+// Presentation engine entry points, routed through the context's simulator if it has one
+
+inline
+VkResult vkwsi_driver_get_surface_capabilities(vkwsi_context* ctx, const VkPhysicalDeviceSurfaceInfo2KHR* info, VkSurfaceCapabilities2KHR* caps)
+{
+#if VKWSI_TESTING
+    if (ctx->simulator) return vkwsi_sim_get_surface_capabilities(ctx, info, caps);
+#endif
+    return ctx->GetPhysicalDeviceSurfaceCapabilities2KHR(ctx->physical_device, info, caps);
+}
+
+inline
+VkResult vkwsi_driver_create_swapchain(vkwsi_context* ctx, const VkSwapchainCreateInfoKHR* info, VkSwapchainKHR* swapchain)
+{
+#if VKWSI_TESTING
+    if (ctx->simulator) return vkwsi_sim_create_swapchain(ctx, info, swapchain);
+#endif
+    return ctx->CreateSwapchainKHR(ctx->device, info, ctx->alloc, swapchain);
+}
+
+inline
+VkResult vkwsi_driver_acquire_next_image(vkwsi_context* ctx, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore, VkFence fence, uint32_t* index)
+{
+#if VKWSI_TESTING
+    if (ctx->simulator) return vkwsi_sim_acquire_next_image(ctx, swapchain, timeout, semaphore, fence, index);
+#endif
+    return ctx->AcquireNextImageKHR(ctx->device, swapchain, timeout, semaphore, fence, index);
+}
+
+inline
+VkResult vkwsi_driver_queue_submit2(vkwsi_context* ctx, VkQueue queue, uint32_t submit_count, const VkSubmitInfo2* submits, VkFence fence)
+{
+#if VKWSI_TESTING
+    if (ctx->simulator) return vkwsi_sim_queue_submit2(ctx, queue, submit_count, submits, fence);
+#endif
+    return ctx->QueueSubmit2(queue, submit_count, submits, fence);
+}
+
+inline
+VkResult vkwsi_driver_queue_present(vkwsi_context* ctx, VkQueue queue, const VkPresentInfoKHR* info)
+{
+#if VKWSI_TESTING
+    if (ctx->simulator) return vkwsi_sim_queue_present(ctx, queue, info);
+#endif
+    return ctx->QueuePresentKHR(queue, info);
+}
@@ -0,0 +1,386 @@
+#include "vk-wsi-impl.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+// -----------------------------------------------------------------------------
+
+// Recording format
+//
+// An 8 byte magic ("VKWSIREC") and format version, followed by a stream of records. Every integer is stored as an
+// unsigned LEB128 varint (VkResults are zigzag encoded first), so typical records are only a handful of bytes.
+//
+//     type, time delta (ns)
+//     create/destroy                  swapchain
+//     set_info                        swapchain, vkwsi_swapchain_info fields (queue families are not recorded)
+//     resize                          swapchain, width, height
+//     acquire/release                 count, swapchains[count], result
+//     present                         count, swapchains[count], host_wait, wait_count, result
+//     driver_acquire/driver_present   frame, swapchain, result
+//     driver_surface_extent           frame, swapchain, width, height
+
+static constexpr char vkwsi_record_magic[8] = { 'V', 'K', 'W', 'S', 'I', 'R', 'E', 'C' };
+static constexpr uint64_t vkwsi_record_version = 1;
+
+struct vkwsi_recorder
+{
+    std::FILE* file = {};
+
+    // NOTE: Driver presents are recorded from the present thread in async mode
+    std::mutex mutex;
+
+    std::chrono::steady_clock::time_point start;
+    uint64_t last_time = 0;
+    uint64_t frame = 0;
+    uint32_t next_swapchain_id = 0;
+
+    vkwsi_unordered_map<uint32_t, VkExtent2D> surface_extents;
+    vkwsi_vector<uint8_t> buffer;
+
+    vkwsi_recorder(const VkAllocationCallbacks* alloc)
+        : surface_extents(alloc)
+        , buffer(alloc)
+    {}
+};
+
+struct vkwsi_record_reader
+{
+    std::vector<uint8_t> data;
+    size_t offset = 0;
+    uint64_t time = 0;
+    std::vector<uint32_t> swapchains;
+};
+
+// -----------------------------------------------------------------------------
+
+static
+void vkwsi_record_write(vkwsi_recorder* recorder, uint64_t value)
+{
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        recorder->buffer.emplace_back(byte | (value ? 0x80 : 0));
+    } while (value);
+}
+
+static
+void vkwsi_record_write_result(vkwsi_recorder* recorder, VkResult result)
+{
+    auto value = int64_t(result);
+    vkwsi_record_write(recorder, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+static
+void vkwsi_record_begin(vkwsi_recorder* recorder, vkwsi_record_type type, std::chrono::steady_clock::time_point time)
+{
+    // NOTE: Calls are recorded when they complete, but timestamped when they started. Clamp so that deltas
+    //       stay positive when a call started before the previously recorded one finished.
+    auto ns = uint64_t(std::max(std::chrono::duration_cast<std::chrono::nanoseconds>(time - recorder->start).count(), int64_t(0)));
+    ns = std::max(ns, recorder->last_time);
+
+    recorder->buffer.clear();
+    vkwsi_record_write(recorder, uint64_t(type));
+    vkwsi_record_write(recorder, ns - recorder->last_time);
+    recorder->last_time = ns;
+}
+
+static
+void vkwsi_record_end(vkwsi_recorder* recorder)
+{
+    std::fwrite(recorder->buffer.data(), 1, recorder->buffer.size(), recorder->file);
+}
+
+// -----------------------------------------------------------------------------
+
+VkResult vkwsi_recorder_create(vkwsi_recorder** pp_recorder, const char* path, const VkAllocationCallbacks* alloc)
+{
+    auto recorder = vkwsi_new<vkwsi_recorder>(alloc, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE, alloc);
+    if (!recorder) return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    auto file = std::fopen(path, "wb");
+    if (!file) {
+        vkwsi_delete(alloc, recorder);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    recorder->file = file;
+    recorder->start = std::chrono::steady_clock::now();
+
+    std::fwrite(vkwsi_record_magic, 1, sizeof(vkwsi_record_magic), file);
+    vkwsi_record_write(recorder, vkwsi_record_version);
+    vkwsi_record_end(recorder);
+
+    *pp_recorder = recorder;
+
+    return VK_SUCCESS;
+}
+
+void vkwsi_recorder_destroy(vkwsi_recorder* recorder, const VkAllocationCallbacks* alloc)
+{
+    std::fclose(recorder->file);
+
+    vkwsi_delete(alloc, recorder);
+}
+
+void vkwsi_record_swapchain(vkwsi_swapchain* swapchain, vkwsi_record_type type, const void* payload)
+{
+    auto recorder = swapchain->ctx->recorder;
+    auto time = std::chrono::steady_clock::now();
+
+    std::scoped_lock lock { recorder->mutex };
+
+    if (type == vkwsi_record_type_swapchain_create) {
+        swapchain->record_id = recorder->next_swapchain_id++;
+    }
+
+    vkwsi_record_begin(recorder, type, time);
+    vkwsi_record_write(recorder, swapchain->record_id);
+
+    if (type == vkwsi_record_type_swapchain_set_info) {
+        auto& info = *static_cast<const vkwsi_swapchain_info*>(payload);
+        vkwsi_record_write(recorder, info.min_image_count);
+        vkwsi_record_write(recorder, info.adaptive_image_count);
+        vkwsi_record_write(recorder, info.format);
+        vkwsi_record_write(recorder, info.color_space);
+        vkwsi_record_write(recorder, info.image_array_layers);
+        vkwsi_record_write(recorder, info.image_usage);
+        vkwsi_record_write(recorder, info.image_sharing_mode);
+        vkwsi_record_write(recorder, info.queue_family_count);
+        vkwsi_record_write(recorder, info.pre_transform);
+        vkwsi_record_write(recorder, info.composite_alpha);
+        vkwsi_record_write(recorder, info.present_mode);
+    } else if (type == vkwsi_record_type_swapchain_resize) {
+        auto& extent = *static_cast<const VkExtent2D*>(payload);
+        vkwsi_record_write(recorder, extent.width);
+        vkwsi_record_write(recorder, extent.height);
+    }
+
+    vkwsi_record_end(recorder);
+}
+
+void vkwsi_record_swapchains(
+    vkwsi_context* ctx, vkwsi_record_type type, std::chrono::steady_clock::time_point time,
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkResult result, bool host_wait, uint32_t wait_count)
+{
+    auto recorder = ctx->recorder;
+
+    std::scoped_lock lock { recorder->mutex };
+
+    vkwsi_record_begin(recorder, type, time);
+    vkwsi_record_write(recorder, swapchain_count);
+    for (uint32_t i = 0; i < swapchain_count; ++i) {
+        vkwsi_record_write(recorder, swapchains[i]->record_id);
+    }
+    if (type == vkwsi_record_type_swapchain_present) {
+        vkwsi_record_write(recorder, host_wait);
+        vkwsi_record_write(recorder, wait_count);
+    }
+    vkwsi_record_write_result(recorder, result);
+    vkwsi_record_end(recorder);
+}
+
+void vkwsi_record_driver_acquire(vkwsi_swapchain* swapchain, VkResult result)
+{
+    auto recorder = swapchain->ctx->recorder;
+    auto time = std::chrono::steady_clock::now();
+
+    std::scoped_lock lock { recorder->mutex };
+
+    vkwsi_record_begin(recorder, vkwsi_record_type_driver_acquire, time);
+    vkwsi_record_write(recorder, recorder->frame);
+    vkwsi_record_write(recorder, swapchain->record_id);
+    vkwsi_record_write_result(recorder, result);
+    vkwsi_record_end(recorder);
+}
+
+void vkwsi_record_driver_present(vkwsi_context* ctx, const vkwsi_present_request& request)
+{
+    auto recorder = ctx->recorder;
+    auto time = std::chrono::steady_clock::now();
+
+    std::scoped_lock lock { recorder->mutex };
+
+    for (uint32_t i = 0; i < request.swapchains.size(); ++i) {
+        vkwsi_record_begin(recorder, vkwsi_record_type_driver_present, time);
+        vkwsi_record_write(recorder, recorder->frame);
+        vkwsi_record_write(recorder, request.swapchains[i]->record_id);
+        vkwsi_record_write_result(recorder, request.results[i]);
+        vkwsi_record_end(recorder);
+    }
+
+    recorder->frame++;
+}
+
+void vkwsi_record_driver_surface_extent(vkwsi_swapchain* swapchain, VkExtent2D extent)
+{
+    auto recorder = swapchain->ctx->recorder;
+    auto time = std::chrono::steady_clock::now();
+
+    std::scoped_lock lock { recorder->mutex };
+
+    // Only record changes
+    auto[iter, inserted] = recorder->surface_extents.try_emplace(swapchain->record_id, extent);
+    if (!inserted) {
+        if (iter->second == extent) return;
+        iter->second = extent;
+    }
+
+    vkwsi_record_begin(recorder, vkwsi_record_type_driver_surface_extent, time);
+    vkwsi_record_write(recorder, recorder->frame);
+    vkwsi_record_write(recorder, swapchain->record_id);
+    vkwsi_record_write(recorder, extent.width);
+    vkwsi_record_write(recorder, extent.height);
+    vkwsi_record_end(recorder);
+}
+
+// -----------------------------------------------------------------------------
+
+static
+bool vkwsi_record_read(vkwsi_record_reader* reader, uint64_t* value)
+{
+    *value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (reader->offset >= reader->data.size()) return false;
+        auto byte = reader->data[reader->offset++];
+        *value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+template<typename T>
+static
+bool vkwsi_record_read(vkwsi_record_reader* reader, T* value)
+{
+    uint64_t v;
+    if (!vkwsi_record_read(reader, &v)) return false;
+    *value = T(v);
+    return true;
+}
+
+static
+bool vkwsi_record_read_result(vkwsi_record_reader* reader, VkResult* result)
+{
+    uint64_t v;
+    if (!vkwsi_record_read(reader, &v)) return false;
+    *result = VkResult(int64_t(v >> 1) ^ -int64_t(v & 1));
+    return true;
+}
+
+VkResult vkwsi_record_reader_open(vkwsi_record_reader** pp_reader, const char* path)
+{
+    auto file = std::fopen(path, "rb");
+    if (!file) return VK_ERROR_INITIALIZATION_FAILED;
+    defer { std::fclose(file); };
+
+    auto reader = new vkwsi_record_reader {};
+
+    uint8_t chunk[4096];
+    size_t count;
+    while ((count = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        reader->data.insert(reader->data.end(), chunk, chunk + count);
+    }
+
+    uint64_t version;
+    if (reader->data.size() < sizeof(vkwsi_record_magic)
+            || std::memcmp(reader->data.data(), vkwsi_record_magic, sizeof(vkwsi_record_magic)) != 0
+            || (reader->offset = sizeof(vkwsi_record_magic), !vkwsi_record_read(reader, &version))
+            || version != vkwsi_record_version) {
+        delete reader;
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    *pp_reader = reader;
+
+    return VK_SUCCESS;
+}
+
+void vkwsi_record_reader_close(vkwsi_record_reader* reader)
+{
+    delete reader;
+}
+
+VkResult vkwsi_record_reader_next(vkwsi_record_reader* reader, vkwsi_record* record)
+{
+    if (reader->offset >= reader->data.size()) return VK_INCOMPLETE;
+
+    *record = {};
+
+    uint64_t time_delta;
+    bool ok = vkwsi_record_read(reader, &record->type)
+        && vkwsi_record_read(reader, &time_delta);
+
+    reader->time += time_delta;
+    record->time = reader->time;
+
+    auto read_swapchain = [&] {
+        reader->swapchains.resize(1);
+        record->swapchains = reader->swapchains.data();
+        record->swapchain_count = 1;
+        return vkwsi_record_read(reader, &reader->swapchains[0]);
+    };
+
+    switch (record->type) {
+        break;case vkwsi_record_type_swapchain_create:
+              case vkwsi_record_type_swapchain_destroy:
+            ok = ok && read_swapchain();
+        break;case vkwsi_record_type_swapchain_set_info: {
+            auto& info = record->info;
+            ok = ok && read_swapchain()
+                && vkwsi_record_read(reader, &info.min_image_count)
+                && vkwsi_record_read(reader, &info.adaptive_image_count)
+                && vkwsi_record_read(reader, &info.format)
+                && vkwsi_record_read(reader, &info.color_space)
+                && vkwsi_record_read(reader, &info.image_array_layers)
+                && vkwsi_record_read(reader, &info.image_usage)
+                && vkwsi_record_read(reader, &info.image_sharing_mode)
+                && vkwsi_record_read(reader, &info.queue_family_count)
+                && vkwsi_record_read(reader, &info.pre_transform)
+                && vkwsi_record_read(reader, &info.composite_alpha)
+                && vkwsi_record_read(reader, &info.present_mode);
+        }
+        break;case vkwsi_record_type_swapchain_resize:
+            ok = ok && read_swapchain()
+                && vkwsi_record_read(reader, &record->extent.width)
+                && vkwsi_record_read(reader, &record->extent.height);
+        break;case vkwsi_record_type_swapchain_acquire:
+              case vkwsi_record_type_swapchain_present:
+              case vkwsi_record_type_swapchain_release: {
+            uint32_t count = 0;
+            ok = ok && vkwsi_record_read(reader, &count) && count <= reader->data.size();
+            reader->swapchains.resize(ok ? count : 0);
+            for (uint32_t i = 0; ok && i < count; ++i) {
+                ok = vkwsi_record_read(reader, &reader->swapchains[i]);
+            }
+            record->swapchains = reader->swapchains.data();
+            record->swapchain_count = count;
+            if (record->type == vkwsi_record_type_swapchain_present) {
+                ok = ok && vkwsi_record_read(reader, &record->host_wait)
+                    && vkwsi_record_read(reader, &record->wait_count);
+            }
+            ok = ok && vkwsi_record_read_result(reader, &record->result);
+        }
+        break;case vkwsi_record_type_driver_acquire:
+              case vkwsi_record_type_driver_present:
+            ok = ok && vkwsi_record_read(reader, &record->frame)
+                && read_swapchain()
+                && vkwsi_record_read_result(reader, &record->result);
+        break;case vkwsi_record_type_driver_surface_extent:
+            ok = ok && vkwsi_record_read(reader, &record->frame)
+                && read_swapchain()
+                && vkwsi_record_read(reader, &record->extent.width)
+                && vkwsi_record_read(reader, &record->extent.height);
+        break;default:
+            ok = false;
+    }
+
+    if (!ok) {
+        // Truncated or corrupt, stop reading
+        reader->offset = reader->data.size();
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    return VK_SUCCESS;
+}
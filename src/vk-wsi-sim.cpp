@@ -0,0 +1,447 @@
+#include "vk-wsi-impl.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+// -----------------------------------------------------------------------------
+
+// Scenario format
+//
+// One directive per line, `#` starts a comment. Global settings:
+//
+//     seed <n>                      Seed for randomized events
+//     frames <n>                    Number of frames to run for (default: last event + 120)
+//     windows <n>                   Number of windows the scenario should be driven with (default: 1)
+//     refresh <hz>                  Refresh rate used for withheld images (default: 60)
+//     caps_lag <frames>             Frames before surface capabilities reflect a surface resize
+//     max_binary_waits <n>          Submissions waiting on more acquire semaphores than this deadlock
+//     random_out_of_date <percent>  Chance for each present to return OUT_OF_DATE
+//
+// Events, applied once `<frame>` presents have been issued:
+//
+//     at <frame> window <w> <h>                    Compositor resizes the window and notifies the application
+//     at <frame> surface <w> <h>                   Compositor resizes the surface without notifying the application
+//     at <frame> out_of_date acquire|present [n]   Next `n` acquires/presents return OUT_OF_DATE
+//     at <frame> suboptimal acquire|present [n]    Next `n` acquires/presents return SUBOPTIMAL
+//     at <frame> acquire_delay <ms>                Delay every subsequent acquire by `ms`
+//     at <frame> withhold <frames>                 Next acquire is blocked for `frames` refresh intervals
+//
+// NOTE: Events are scheduled by present count and random events are drawn from a seeded generator, so a scenario
+//       replays identically for the same sequence of API calls.
+
+enum class vkwsi_sim_event_type
+{
+    window,
+    surface,
+    acquire_out_of_date,
+    present_out_of_date,
+    acquire_suboptimal,
+    present_suboptimal,
+    acquire_delay,
+    withhold,
+};
+
+struct vkwsi_sim_event
+{
+    uint64_t frame;
+    vkwsi_sim_event_type type;
+    uint32_t args[2];
+};
+
+struct vkwsi_sim_lagged_extent
+{
+    uint64_t frame;
+    VkExtent2D extent;
+};
+
+struct vkwsi_simulator
+{
+    vkwsi_log_callback log_callback = {};
+
+    // Scenario
+
+    uint32_t seed = 0;
+    uint64_t frame_count = 0;
+    uint32_t window_count = 1;
+    uint32_t refresh_hz = 60;
+    uint32_t caps_lag = 0;
+    uint32_t max_binary_waits = UINT32_MAX;
+    uint32_t random_out_of_date = 0;
+
+    std::vector<vkwsi_sim_event> events;
+
+    // State
+
+    // NOTE: Presents may be issued from the async present thread concurrently with acquires
+    std::mutex mutex;
+
+    std::mt19937 rng;
+    uint64_t frame = 0;
+    size_t next_event = 0;
+
+    bool has_surface_extent = false;
+    VkExtent2D window_extent = {};
+    VkExtent2D surface_extent = {};
+    VkExtent2D reported_extent = {};
+    std::deque<vkwsi_sim_lagged_extent> lagged_extents;
+
+    uint32_t acquire_out_of_date = 0;
+    uint32_t present_out_of_date = 0;
+    uint32_t acquire_suboptimal = 0;
+    uint32_t present_suboptimal = 0;
+    std::chrono::milliseconds acquire_delay = {};
+    uint32_t withhold_frames = 0;
+
+    std::unordered_map<VkSwapchainKHR, VkExtent2D> swapchain_extents;
+    std::unordered_set<VkSemaphore> acquire_semaphores;
+
+    bool resize_pending = false;
+    uint64_t resize_frame = 0;
+    std::chrono::steady_clock::time_point resize_time;
+
+    vkwsi_simulator_stats stats = {};
+};
+
+// -----------------------------------------------------------------------------
+
+static
+void vkwsi_sim_set_surface_extent(vkwsi_simulator* sim, VkExtent2D extent)
+{
+    if (sim->has_surface_extent && sim->surface_extent == extent) return;
+
+    if (!sim->has_surface_extent) {
+        // Initial size is visible immediately
+        sim->reported_extent = extent;
+    }
+
+    sim->has_surface_extent = true;
+    sim->surface_extent = extent;
+    sim->lagged_extents.push_back({ sim->frame + sim->caps_lag, extent });
+
+    sim->stats.resizes++;
+    sim->resize_pending = true;
+    sim->resize_frame = sim->frame;
+    sim->resize_time = std::chrono::steady_clock::now();
+}
+
+static
+void vkwsi_sim_advance(vkwsi_simulator* sim)
+{
+    while (sim->next_event < sim->events.size() && sim->events[sim->next_event].frame <= sim->frame) {
+        auto& event = sim->events[sim->next_event++];
+        switch (event.type) {
+            break;case vkwsi_sim_event_type::window:
+                sim->window_extent = { event.args[0], event.args[1] };
+                vkwsi_sim_set_surface_extent(sim, sim->window_extent);
+            break;case vkwsi_sim_event_type::surface:
+                vkwsi_sim_set_surface_extent(sim, { event.args[0], event.args[1] });
+            break;case vkwsi_sim_event_type::acquire_out_of_date: sim->acquire_out_of_date += event.args[0];
+            break;case vkwsi_sim_event_type::present_out_of_date: sim->present_out_of_date += event.args[0];
+            break;case vkwsi_sim_event_type::acquire_suboptimal:  sim->acquire_suboptimal  += event.args[0];
+            break;case vkwsi_sim_event_type::present_suboptimal:  sim->present_suboptimal  += event.args[0];
+            break;case vkwsi_sim_event_type::acquire_delay: sim->acquire_delay = std::chrono::milliseconds(event.args[0]);
+            break;case vkwsi_sim_event_type::withhold:      sim->withhold_frames += event.args[0];
+        }
+    }
+
+    while (!sim->lagged_extents.empty() && sim->lagged_extents.front().frame <= sim->frame) {
+        sim->reported_extent = sim->lagged_extents.front().extent;
+        sim->lagged_extents.pop_front();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// NOTE: The simulator wraps the context's own driver functions, so that it only ever sees calls from its context
+
+VkResult vkwsi_sim_get_surface_capabilities(vkwsi_context* ctx, const VkPhysicalDeviceSurfaceInfo2KHR* info, VkSurfaceCapabilities2KHR* caps)
+{
+    auto sim = ctx->simulator;
+    VkResult res;
+
+    res = ctx->GetPhysicalDeviceSurfaceCapabilities2KHR(ctx->physical_device, info, caps);
+    VKWSI_CHECK(res);
+
+    std::scoped_lock lock { sim->mutex };
+    vkwsi_sim_advance(sim);
+
+    if (sim->has_surface_extent) {
+        auto& surface_caps = caps->surfaceCapabilities;
+        surface_caps.currentExtent = surface_caps.minImageExtent = surface_caps.maxImageExtent = sim->reported_extent;
+
+        // Scaling would let any extent through, simulate a compositor that requires an exact match
+        for (auto* next = static_cast<VkBaseOutStructure*>(caps->pNext); next; next = next->pNext) {
+            if (next->sType == VK_STRUCTURE_TYPE_SURFACE_PRESENT_SCALING_CAPABILITIES_EXT) {
+                reinterpret_cast<VkSurfacePresentScalingCapabilitiesEXT*>(next)->supportedPresentScaling = 0;
+            }
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult vkwsi_sim_create_swapchain(vkwsi_context* ctx, const VkSwapchainCreateInfoKHR* info, VkSwapchainKHR* swapchain)
+{
+    auto sim = ctx->simulator;
+    VkResult res;
+
+    res = ctx->CreateSwapchainKHR(ctx->device, info, ctx->alloc, swapchain);
+    VKWSI_CHECK(res);
+
+    std::scoped_lock lock { sim->mutex };
+    sim->swapchain_extents[*swapchain] = info->imageExtent;
+
+    return VK_SUCCESS;
+}
+
+VkResult vkwsi_sim_acquire_next_image(
+    vkwsi_context* ctx, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore, VkFence fence, uint32_t* index)
+{
+    auto sim = ctx->simulator;
+
+    std::chrono::nanoseconds delay;
+    bool suboptimal = false;
+    {
+        std::scoped_lock lock { sim->mutex };
+
+        if (sim->acquire_out_of_date) {
+            sim->acquire_out_of_date--;
+            sim->stats.injected_out_of_date++;
+            return VK_ERROR_OUT_OF_DATE_KHR;
+        }
+
+        if (sim->acquire_suboptimal) {
+            sim->acquire_suboptimal--;
+            suboptimal = true;
+        }
+
+        delay = sim->acquire_delay + std::chrono::nanoseconds(std::nano::den / sim->refresh_hz) * sim->withhold_frames;
+        sim->withhold_frames = 0;
+
+        sim->acquire_semaphores.insert(semaphore);
+    }
+
+    if (delay.count()) std::this_thread::sleep_for(delay);
+
+    auto res = ctx->AcquireNextImageKHR(ctx->device, swapchain, timeout, semaphore, fence, index);
+    if (res == VK_SUCCESS && suboptimal) {
+        std::scoped_lock lock { sim->mutex };
+        sim->stats.injected_suboptimal++;
+        res = VK_SUBOPTIMAL_KHR;
+    }
+
+    return res;
+}
+
+VkResult vkwsi_sim_queue_submit2(vkwsi_context* ctx, VkQueue queue, uint32_t submit_count, const VkSubmitInfo2* submits, VkFence fence)
+{
+    auto sim = ctx->simulator;
+
+    {
+        std::scoped_lock lock { sim->mutex };
+
+        for (uint32_t i = 0; i < submit_count; ++i) {
+            uint32_t binary_waits = 0;
+            for (uint32_t j = 0; j < submits[i].waitSemaphoreInfoCount; ++j) {
+                if (sim->acquire_semaphores.contains(submits[i].pWaitSemaphoreInfos[j].semaphore)) binary_waits++;
+            }
+
+            if (binary_waits > sim->max_binary_waits) {
+                sim->stats.deadlocks++;
+                VKWSI_LOG(sim, vkwsi_log_level_error, "Simulated deadlock: submission waits on {} acquire semaphores (max {})",
+                    binary_waits, sim->max_binary_waits);
+                return VK_ERROR_DEVICE_LOST;
+            }
+        }
+    }
+
+    return ctx->QueueSubmit2(queue, submit_count, submits, fence);
+}
+
+VkResult vkwsi_sim_queue_present(vkwsi_context* ctx, VkQueue queue, const VkPresentInfoKHR* info)
+{
+    auto sim = ctx->simulator;
+
+    auto res = ctx->QueuePresentKHR(queue, info);
+
+    std::scoped_lock lock { sim->mutex };
+
+    if (sim->resize_pending && res >= 0) {
+        bool recovered = true;
+        for (uint32_t i = 0; i < info->swapchainCount; ++i) {
+            auto extent = sim->swapchain_extents[info->pSwapchains[i]];
+            if (!(extent == sim->surface_extent)) recovered = false;
+        }
+
+        if (recovered) {
+            auto frames = sim->frame - sim->resize_frame;
+            auto ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sim->resize_time).count());
+            sim->stats.recovered_resizes++;
+            sim->stats.total_recovery_frames += frames;
+            sim->stats.max_recovery_frames = std::max(sim->stats.max_recovery_frames, frames);
+            sim->stats.total_recovery_ns += ns;
+            sim->stats.max_recovery_ns = std::max(sim->stats.max_recovery_ns, ns);
+            sim->resize_pending = false;
+        }
+    }
+
+    // Presents still go ahead when injecting errors, so that waits and present fences complete as normal
+
+    auto inject = [&](VkResult result) {
+        if (res < 0) return;
+        res = result;
+        if (info->pResults) {
+            for (uint32_t i = 0; i < info->swapchainCount; ++i) info->pResults[i] = result;
+        }
+    };
+
+    if (sim->present_out_of_date) {
+        sim->present_out_of_date--;
+        sim->stats.injected_out_of_date++;
+        inject(VK_ERROR_OUT_OF_DATE_KHR);
+    } else if (sim->random_out_of_date && sim->rng() % 100 < sim->random_out_of_date) {
+        sim->stats.injected_out_of_date++;
+        inject(VK_ERROR_OUT_OF_DATE_KHR);
+    } else if (sim->present_suboptimal) {
+        sim->present_suboptimal--;
+        sim->stats.injected_suboptimal++;
+        inject(VK_SUBOPTIMAL_KHR);
+    }
+
+    sim->frame++;
+    sim->stats.frames = sim->frame;
+    vkwsi_sim_advance(sim);
+
+    return res;
+}
+
+// -----------------------------------------------------------------------------
+
+static
+VkResult vkwsi_sim_parse(vkwsi_simulator* sim, const char* scenario)
+{
+    std::istringstream input { scenario };
+    std::string line;
+    uint32_t line_number = 0;
+
+    auto fail = [&](std::string_view reason) {
+        VKWSI_LOG(sim, vkwsi_log_level_error, "Scenario line {}: {} ({})", line_number, reason, line);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    };
+
+    while (std::getline(input, line)) {
+        line_number++;
+
+        std::istringstream tokens { line.substr(0, line.find('#')) };
+        std::string directive;
+        if (!(tokens >> directive)) continue;
+
+        if      (directive == "seed")               tokens >> sim->seed;
+        else if (directive == "frames")             tokens >> sim->frame_count;
+        else if (directive == "windows")            tokens >> sim->window_count;
+        else if (directive == "refresh")            tokens >> sim->refresh_hz;
+        else if (directive == "caps_lag")           tokens >> sim->caps_lag;
+        else if (directive == "max_binary_waits")   tokens >> sim->max_binary_waits;
+        else if (directive == "random_out_of_date") tokens >> sim->random_out_of_date;
+        else if (directive == "at") {
+            vkwsi_sim_event event = {};
+            std::string type;
+            if (!(tokens >> event.frame >> type)) return fail("expected frame and event");
+
+            if (type == "window" || type == "surface") {
+                event.type = type == "window" ? vkwsi_sim_event_type::window : vkwsi_sim_event_type::surface;
+                tokens >> event.args[0] >> event.args[1];
+            } else if (type == "out_of_date" || type == "suboptimal") {
+                std::string target;
+                tokens >> target;
+                if (target != "acquire" && target != "present") return fail("expected acquire or present");
+                bool acquire = target == "acquire";
+                event.type = type == "out_of_date"
+                    ? (acquire ? vkwsi_sim_event_type::acquire_out_of_date : vkwsi_sim_event_type::present_out_of_date)
+                    : (acquire ? vkwsi_sim_event_type::acquire_suboptimal  : vkwsi_sim_event_type::present_suboptimal);
+                if (!(tokens >> event.args[0])) {
+                    event.args[0] = 1;
+                    tokens.clear();
+                }
+            } else if (type == "acquire_delay") {
+                event.type = vkwsi_sim_event_type::acquire_delay;
+                tokens >> event.args[0];
+            } else if (type == "withhold") {
+                event.type = vkwsi_sim_event_type::withhold;
+                tokens >> event.args[0];
+            } else {
+                return fail("unknown event");
+            }
+
+            sim->events.emplace_back(event);
+        } else {
+            return fail("unknown directive");
+        }
+
+        if (tokens.fail()) return fail("invalid arguments");
+    }
+
+    if (sim->refresh_hz == 0) return fail("refresh must be non-zero");
+
+    // Events for the same frame are applied in file order
+    std::ranges::stable_sort(sim->events, {}, &vkwsi_sim_event::frame);
+
+    if (!sim->frame_count) {
+        sim->frame_count = (sim->events.empty() ? 0 : sim->events.back().frame) + 120;
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult vkwsi_simulator_create(vkwsi_simulator** pp_sim, const char* scenario, vkwsi_log_callback log_callback)
+{
+    VkResult res;
+
+    auto sim = new vkwsi_simulator {};
+    sim->log_callback = log_callback;
+
+    res = vkwsi_sim_parse(sim, scenario);
+    if (res != VK_SUCCESS) {
+        delete sim;
+        return res;
+    }
+
+    sim->rng.seed(sim->seed);
+    vkwsi_sim_advance(sim);
+
+    *pp_sim = sim;
+
+    return VK_SUCCESS;
+}
+
+void vkwsi_simulator_destroy(vkwsi_simulator* sim)
+{
+    delete sim;
+}
+
+uint64_t vkwsi_simulator_get_frame_count(vkwsi_simulator* sim)
+{
+    return sim->frame_count;
+}
+
+uint32_t vkwsi_simulator_get_window_count(vkwsi_simulator* sim)
+{
+    return sim->window_count;
+}
+
+VkExtent2D vkwsi_simulator_get_window_extent(vkwsi_simulator* sim)
+{
+    std::scoped_lock lock { sim->mutex };
+    return sim->window_extent;
+}
+
+vkwsi_simulator_stats vkwsi_simulator_get_stats(vkwsi_simulator* sim)
+{
+    std::scoped_lock lock { sim->mutex };
+    return sim->stats;
+}
@@ -1,37 +1,17 @@
 #include "vk-wsi-impl.hpp"
 
-#include <format>
 #include <utility>
 #include <concepts>
 #include <algorithm>
+#include <numeric>
 #include <numbers>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <string_view>
 
 // -----------------------------------------------------------------------------
 
-static
-void vkwsi_log_(vkwsi_context* ctx, vkwsi_log_level level, const char* message)
-{
-    ctx->log_callback.fn(ctx->log_callback.data, level, message);
-}
-
-template<typename ...Args>
-static
-void vkwsi_log_(vkwsi_context* ctx, vkwsi_log_level level, std::format_string<Args...> fmt, Args&&... args)
-{
-    ctx->log_callback.fn(ctx->log_callback.data, level, std::vformat(fmt.get(), std::make_format_args(args...)).c_str());
-}
-
-#define VKWSI_LOG(ctx, level, fmt, ...) \
-    if ((ctx)->log_callback.fn) vkwsi_log_(ctx, level, fmt __VA_OPT__(,) __VA_ARGS__)
-
-// -----------------------------------------------------------------------------
-
-static
-auto* vkwsi_temp(auto&& v)
-{
-    return &v;
-}
-
 template<typename Container, typename Fn, typename... Args>
 static
 auto vkwsi_enumerate(Container& container, Fn&& fn, Args&&... args)
@@ -57,12 +37,38 @@ auto vkwsi_enumerate(Container& container, Fn&& fn, Args&&... args)
 }
 
 static
-constexpr bool operator==(VkExtent2D l, VkExtent2D r)
+constexpr bool operator==(const vkwsi_swapchain_info& l, const vkwsi_swapchain_info& r)
+{
+    return l.min_image_count == r.min_image_count
+        && l.format == r.format
+        && l.color_space == r.color_space
+        && l.image_array_layers == r.image_array_layers
+        && l.image_usage == r.image_usage
+        && l.image_sharing_mode == r.image_sharing_mode
+        && l.queue_families == r.queue_families
+        && l.queue_family_count == r.queue_family_count
+        && l.pre_transform == r.pre_transform
+        && l.composite_alpha == r.composite_alpha
+        && l.present_mode == r.present_mode
+        && l.acquire_layout == r.acquire_layout
+        && l.present_layout == r.present_layout
+        && l.adaptive_image_count == r.adaptive_image_count;
+}
+
+static
+bool vkwsi_is_shared_present_mode(VkPresentModeKHR present_mode)
 {
-    return l.width == r.width && l.height == r.height;
+    return present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR
+        || present_mode == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR;
 }
 
-#define VKWSI_CHECK(vkwsi_res) if (vkwsi_res != VK_SUCCESS) return res
+// FIFO modes show every present on a refresh of its own, so their completion times line up with the display's refreshes
+static
+bool vkwsi_is_timed_present_mode(VkPresentModeKHR present_mode)
+{
+    return present_mode == VK_PRESENT_MODE_FIFO_KHR
+        || present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+}
 
 // -----------------------------------------------------------------------------
 
@@ -84,6 +90,118 @@ VkResult vkwsi_h_wait_and_reset_fence(vkwsi_context* ctx, VkFence fence)
 
 // -----------------------------------------------------------------------------
 
+static
+void vkwsi_worker_pool_work(vkwsi_worker_pool* pool, vkwsi_job_fn job, void* job_data, uint32_t job_count)
+{
+    for (;;) {
+        auto index = pool->next_job.fetch_add(1, std::memory_order_relaxed);
+        if (index >= job_count) break;
+        job(job_data, index);
+    }
+}
+
+static
+void vkwsi_worker_pool_thread_main(vkwsi_worker_pool* pool)
+{
+    uint64_t generation = 0;
+
+    std::unique_lock lock { pool->mutex };
+    for (;;) {
+        pool->work_cv.wait(lock, [&] { return pool->stop || pool->generation != generation; });
+        if (pool->stop) break;
+        generation = pool->generation;
+
+        // NOTE: A worker that wakes after the batch has already completed sees `job_count == 0`. Otherwise it is counted
+        //       in `active` before the batch can complete, so the batch can't be replaced while it is still reading it.
+        auto job = pool->job;
+        auto job_data = pool->job_data;
+        auto job_count = pool->job_count;
+        if (job_count == 0) continue;
+        pool->active++;
+
+        lock.unlock();
+        vkwsi_worker_pool_work(pool, job, job_data, job_count);
+        lock.lock();
+
+        if (--pool->active == 0) pool->done_cv.notify_all();
+    }
+}
+
+static
+void vkwsi_worker_pool_destroy(vkwsi_worker_pool* pool, const VkAllocationCallbacks* alloc)
+{
+    {
+        std::scoped_lock lock { pool->mutex };
+        pool->stop = true;
+    }
+    pool->work_cv.notify_all();
+
+    for (auto& thread : pool->threads) thread.join();
+
+    vkwsi_delete(alloc, pool);
+}
+
+static
+VkResult vkwsi_worker_pool_create(vkwsi_worker_pool** pp_pool, uint32_t thread_count, const VkAllocationCallbacks* alloc)
+{
+    auto pool = vkwsi_new<vkwsi_worker_pool>(alloc, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE, alloc);
+    if (!pool) return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    try {
+        pool->threads.reserve(thread_count);
+    } catch (const std::bad_alloc&) {
+        vkwsi_delete(alloc, pool);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    try {
+        for (uint32_t i = 0; i < thread_count; ++i) {
+            pool->threads.emplace_back(vkwsi_worker_pool_thread_main, pool);
+        }
+    } catch (const std::system_error&) {
+        // NOTE: Stops and joins the threads that did start
+        vkwsi_worker_pool_destroy(pool, alloc);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    } catch (const std::bad_alloc&) {
+        vkwsi_worker_pool_destroy(pool, alloc);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    *pp_pool = pool;
+
+    return VK_SUCCESS;
+}
+
+static
+void vkwsi_worker_pool_run(vkwsi_worker_pool* pool, vkwsi_job_fn job, void* job_data, uint32_t job_count)
+{
+    // NOTE: Another thread is already using the pool, don't serialize behind it
+    std::unique_lock dispatch { pool->dispatch_mutex, std::try_to_lock };
+    if (!dispatch) {
+        for (uint32_t i = 0; i < job_count; ++i) job(job_data, i);
+        return;
+    }
+
+    {
+        std::scoped_lock lock { pool->mutex };
+        pool->job = job;
+        pool->job_data = job_data;
+        pool->job_count = job_count;
+        pool->next_job.store(0, std::memory_order_relaxed);
+        pool->generation++;
+    }
+    pool->work_cv.notify_all();
+
+    // The dispatching thread takes jobs too
+    vkwsi_worker_pool_work(pool, job, job_data, job_count);
+
+    std::unique_lock lock { pool->mutex };
+    pool->done_cv.wait(lock, [&] { return pool->active == 0; });
+    pool->job_count = 0;
+}
+
+// -----------------------------------------------------------------------------
+
 vkwsi_swapchain_info vkwsi_swapchain_info_default()
 {
     return {
@@ -103,31 +221,70 @@ vkwsi_swapchain_info vkwsi_swapchain_info_default()
         .composite_alpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
 
         .present_mode = VK_PRESENT_MODE_FIFO_KHR,
+
+        .acquire_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .present_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+
+        .adaptive_image_count = false,
     };
 }
 
 static
-VkResult vkwsi_recover_binary_semaphores(vkwsi_context* ctx);
+VkResult vkwsi_recover_binary_semaphores(vkwsi_context* ctx, vkwsi_queue_state* state);
 
-VkResult vkwsi_context_create(vkwsi_context** pp_ctx, const vkwsi_context_info* info)
-{
-    VkResult res;
+static
+void vkwsi_destroy_queue_state(vkwsi_context* ctx, vkwsi_queue_state* state);
+
+static
+void vkwsi_present_thread_main(vkwsi_context* ctx);
 
-    auto ctx = new vkwsi_context {};
-    // TODO: Cleanup on error
+static
+void vkwsi_wait_queued_presents(vkwsi_swapchain* swapchain, uint32_t max_queued);
 
-    if (!info->instance || !info->device || !info->physical_device) {
-        return VK_ERROR_INITIALIZATION_FAILED;
-    }
+// NOTE: On failure the caller destroys the partially initialized context
+static
+VkResult vkwsi_context_init(vkwsi_context* ctx, const vkwsi_context_info* info)
+{
+    VkResult res;
 
     ctx->instance = info->instance;
     ctx->device = info->device;
     ctx->physical_device = info->physical_device;
     ctx->log_callback = info->log_callback;
+    ctx->host_wait_timeout = info->host_wait_timeout ? info->host_wait_timeout : UINT64_MAX;
 
     vkwsi_init_functions(ctx, info->instance, info->device, info->get_instance_proc_addr);
     // TODO: Check that required functions have loaded
 
+    bool present_id = false;
+    bool present_wait = false;
+    for (uint32_t i = 0; i < info->enabled_device_extension_count; ++i) {
+        auto name = std::string_view(info->enabled_device_extensions[i]);
+        if (name == VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME) ctx->incremental_present = true;
+        if (name == VK_KHR_SHARED_PRESENTABLE_IMAGE_EXTENSION_NAME) ctx->shared_presentable_image = true;
+        if (name == VK_KHR_PRESENT_ID_EXTENSION_NAME) present_id = true;
+        if (name == VK_KHR_PRESENT_WAIT_EXTENSION_NAME) present_wait = true;
+        if (name == VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) ctx->display_timing = bool(ctx->GetPastPresentationTimingGOOGLE);
+    }
+    ctx->present_wait = present_id && present_wait && ctx->WaitForPresentKHR;
+
+#if VKWSI_TESTING
+    ctx->simulator = info->simulator;
+
+    if (info->record_path) {
+        res = vkwsi_recorder_create(&ctx->recorder, info->record_path, ctx->alloc);
+        if (res != VK_SUCCESS) {
+            VKWSI_LOG(ctx, vkwsi_log_level_error, "Failed to open recording file: {}", info->record_path);
+            return res;
+        }
+    }
+#else
+    if (info->simulator || info->record_path) {
+        VKWSI_LOG(ctx, vkwsi_log_level_error, "Simulation and recording require building with VKWSI_ENABLE_TESTING");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+#endif
+
 #if VKWSI_DEBUG_LINEARIZE
     res = ctx->CreateFence(ctx->device, vkwsi_temp(VkFenceCreateInfo {
         .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
@@ -135,15 +292,42 @@ VkResult vkwsi_context_create(vkwsi_context** pp_ctx, const vkwsi_context_info*
     VKWSI_CHECK(res);
 #endif
 
-    res = ctx->CreateSemaphore(ctx->device, vkwsi_temp(VkSemaphoreCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        .pNext = vkwsi_temp(VkSemaphoreTypeCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
-            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
-            .initialValue = 0,
-        }),
-    }), nullptr, &ctx->timeline);
-    VKWSI_CHECK(res);
+    if (info->async_present) {
+        ctx->async_present = true;
+        ctx->present_thread = std::thread(vkwsi_present_thread_main, ctx);
+    }
+
+    if (info->acquire_job_callback.fn) {
+        ctx->acquire_job_callback = info->acquire_job_callback;
+    } else if (info->acquire_thread_count > 1) {
+        res = vkwsi_worker_pool_create(&ctx->acquire_workers, info->acquire_thread_count - 1, ctx->alloc);
+        VKWSI_CHECK(res);
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult vkwsi_context_create(vkwsi_context** pp_ctx, const vkwsi_context_info* info)
+{
+    VkResult res;
+
+    if (!info->instance || !info->device || !info->physical_device) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    auto ctx = vkwsi_new<vkwsi_context>(info->allocation_callbacks, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE, info->allocation_callbacks);
+    if (!ctx) return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    try {
+        res = vkwsi_context_init(ctx, info);
+    } catch (const std::bad_alloc&) {
+        res = VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    if (res != VK_SUCCESS) {
+        vkwsi_context_destroy(ctx);
+        return res;
+    }
 
     *pp_ctx = ctx;
 
@@ -152,23 +336,35 @@ VkResult vkwsi_context_create(vkwsi_context** pp_ctx, const vkwsi_context_info*
 
 void vkwsi_context_destroy(vkwsi_context* ctx)
 {
+    if (ctx->present_thread.joinable()) {
+        auto& slot = ctx->present_queue.begin_push();
+        slot.value.stop = true;
+        ctx->present_queue.end_push(slot);
+        ctx->present_thread.join();
+    }
+
+    if (ctx->acquire_workers) {
+        vkwsi_worker_pool_destroy(ctx->acquire_workers, ctx->alloc);
+    }
+
 #if VKWSI_DEBUG_LINEARIZE
     ctx->DestroyFence(ctx->device, ctx->debug_fence, ctx->alloc);
 #endif
 
-    vkwsi_recover_binary_semaphores(ctx);
-
-    for (auto& sema : ctx->binary_semaphores) {
-        ctx->DestroySemaphore(ctx->device, sema, ctx->alloc);
+    for (auto& slot : ctx->queue_states) {
+        if (auto state = slot.load(std::memory_order_acquire)) {
+            vkwsi_recover_binary_semaphores(ctx, state);
+            vkwsi_destroy_queue_state(ctx, state);
+        }
     }
 
-    for (auto fence : ctx->fences) {
-        ctx->DestroyFence(ctx->device, fence, ctx->alloc);
+    if (ctx->recorder) {
+        vkwsi_recorder_destroy(ctx->recorder, ctx->alloc);
     }
 
-    ctx->DestroySemaphore(ctx->device, ctx->timeline, ctx->alloc);
-
-    delete ctx;
+    // NOTE: Copy the callbacks out, as `ctx->alloc` points into the context being freed
+    auto alloc_callbacks = ctx->alloc_callbacks;
+    vkwsi_delete(ctx->alloc ? &alloc_callbacks : nullptr, ctx);
 }
 
 VkPresentModeKHR vkwsi_context_pick_present_mode(vkwsi_context* ctx, VkSurfaceKHR surface, const VkPresentModeKHR* present_modes, uint32_t present_mode_count)
@@ -188,7 +384,7 @@ VkPresentModeKHR vkwsi_context_pick_present_mode(vkwsi_context* ctx, VkSurfaceKH
         }
     };
 
-    std::vector<VkPresentModeKHR> available_present_modes;
+    vkwsi_vector<VkPresentModeKHR> available_present_modes { ctx->alloc };
     res = vkwsi_enumerate(available_present_modes, ctx->GetPhysicalDeviceSurfacePresentModesKHR, ctx->physical_device, surface);
     VKWSI_LOG(ctx, vkwsi_log_level_trace, "AVAILABLE PRESENT MODES:");
     for (auto pm : available_present_modes) {
@@ -198,6 +394,10 @@ VkPresentModeKHR vkwsi_context_pick_present_mode(vkwsi_context* ctx, VkSurfaceKH
     for (uint32_t i = 0; i < present_mode_count; ++i) {
         auto pm = present_modes[i];
         VKWSI_LOG(ctx, vkwsi_log_level_trace, "CHECKING PRESENT MODE: {}", present_mode_to_string(pm));
+        if (vkwsi_is_shared_present_mode(pm) && !ctx->shared_presentable_image) {
+            VKWSI_LOG(ctx, vkwsi_log_level_trace, "  VK_KHR_shared_presentable_image NOT ENABLED");
+            continue;
+        }
         auto begin = available_present_modes.begin();
         auto end = available_present_modes.end();
         if (std::find(begin, end, pm) != end) {
@@ -212,12 +412,83 @@ VkPresentModeKHR vkwsi_context_pick_present_mode(vkwsi_context* ctx, VkSurfaceKH
 }
 
 static
-VkResult vkwsi_get_fence(vkwsi_context* ctx, VkFence* p_fence)
+VkResult vkwsi_get_queue_state(vkwsi_context* ctx, VkQueue queue, vkwsi_queue_state** p_state)
+{
+    VkResult res;
+
+    for (auto& slot : ctx->queue_states) {
+        auto state = slot.load(std::memory_order_acquire);
+        if (!state) break;
+        if (state->queue == queue) {
+            *p_state = state;
+            return VK_SUCCESS;
+        }
+    }
+
+    // NOTE: Only the thread currently using `queue` can be inserting it, except for async present queues. Racing
+    //       inserts of the same queue are resolved below, every caller must end up with the same state.
+
+    auto state = vkwsi_new<vkwsi_queue_state>(ctx->alloc, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, ctx->alloc);
+    if (!state) return VK_ERROR_OUT_OF_HOST_MEMORY;
+    state->queue = queue;
+
+    res = ctx->CreateSemaphore(ctx->device, vkwsi_temp(VkSemaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = vkwsi_temp(VkSemaphoreTypeCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        }),
+    }), ctx->alloc, &state->timeline);
+    if (res != VK_SUCCESS) {
+        vkwsi_delete(ctx->alloc, state);
+        return res;
+    }
+
+    for (auto& slot : ctx->queue_states) {
+        vkwsi_queue_state* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, state, std::memory_order_acq_rel)) {
+            *p_state = state;
+            return VK_SUCCESS;
+        }
+        if (expected->queue == queue) {
+            // NOTE: Another thread inserted the same queue first, its timeline must be the only one used for it
+            vkwsi_destroy_queue_state(ctx, state);
+            *p_state = expected;
+            return VK_SUCCESS;
+        }
+    }
+
+    VKWSI_LOG(ctx, vkwsi_log_level_error, "Exceeded VKWSI_MAX_QUEUES ({})", VKWSI_MAX_QUEUES);
+    vkwsi_destroy_queue_state(ctx, state);
+    return VK_ERROR_TOO_MANY_OBJECTS;
+}
+
+static
+void vkwsi_destroy_queue_state(vkwsi_context* ctx, vkwsi_queue_state* state)
+{
+    for (auto& sema : state->binary_semaphores) {
+        ctx->DestroySemaphore(ctx->device, sema, ctx->alloc);
+    }
+
+    for (auto* present_semaphore : state->present_semaphores) {
+        ctx->DestroySemaphore(ctx->device, present_semaphore->semaphore, ctx->alloc);
+        vkwsi_delete(ctx->alloc, present_semaphore);
+    }
+
+    ctx->DestroySemaphore(ctx->device, state->timeline, ctx->alloc);
+
+    vkwsi_delete(ctx->alloc, state);
+}
+
+static
+VkResult vkwsi_get_fence(vkwsi_swapchain* swapchain, VkFence* p_fence)
 {
+    auto ctx = swapchain->ctx;
     VkResult res;
 
-    if (ctx->fences.empty()) {
-        static uint64_t debug_allocated_count = 0;
+    if (swapchain->fences.empty()) {
+        static std::atomic<uint64_t> debug_allocated_count = 0;
         VKWSI_LOG(ctx, vkwsi_log_level_warn, "Allocated new fence: {}", ++debug_allocated_count);
 
         VkFence fence;
@@ -228,75 +499,124 @@ VkResult vkwsi_get_fence(vkwsi_context* ctx, VkFence* p_fence)
 
         *p_fence = fence;
     } else {
-        *p_fence = ctx->fences.back();
-        ctx->fences.pop_back();
+        *p_fence = swapchain->fences.back();
+        swapchain->fences.pop_back();
     }
 
     return VK_SUCCESS;
 }
 
 static
-VkResult vkwsi_return_fence(vkwsi_context* ctx, VkFence fence)
+VkResult vkwsi_return_fence(vkwsi_swapchain* swapchain, VkFence fence)
 {
+    auto ctx = swapchain->ctx;
     VkResult res;
 
     res = ctx->ResetFences(ctx->device, 1, &fence);
     VKWSI_CHECK(res);
 
-    ctx->fences.emplace_back(fence);
+    swapchain->fences.emplace_back(fence);
 
     return VK_SUCCESS;
 }
 
 static
-VkResult vkwsi_get_binary_semaphore(vkwsi_context* ctx, VkSemaphore* p_semaphore)
+VkResult vkwsi_create_binary_semaphore(vkwsi_context* ctx, VkSemaphore* p_semaphore)
 {
-    VkResult res;
+    // TODO: Separate debug tracking for acquire and present semaphores
+    static std::atomic<uint64_t> debug_allocated_count = 0;
+    VKWSI_LOG(ctx, vkwsi_log_level_warn, "Allocated new binary sempahore: {}", ++debug_allocated_count);
 
-    if (ctx->binary_semaphores.empty()) {
-        // TODO: Separate debug tracking for acquire and present semaphores
-        static uint64_t debug_allocated_count = 0;
-        VKWSI_LOG(ctx, vkwsi_log_level_warn, "Allocated new binary sempahore: {}", ++debug_allocated_count);
+    return ctx->CreateSemaphore(ctx->device, vkwsi_temp(VkSemaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    }), ctx->alloc, p_semaphore);
+}
 
-        VkSemaphore semaphore;
-        res = ctx->CreateSemaphore(ctx->device, vkwsi_temp(VkSemaphoreCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        }), ctx->alloc, &semaphore);
-        VKWSI_CHECK(res);
+static
+VkResult vkwsi_get_binary_semaphore(vkwsi_context* ctx, vkwsi_queue_state* state, VkSemaphore* p_semaphore)
+{
+    VkResult res;
 
-        *p_semaphore = semaphore;
+    if (state->binary_semaphores.empty()) {
+        res = vkwsi_create_binary_semaphore(ctx, p_semaphore);
+        VKWSI_CHECK(res);
     } else {
-        *p_semaphore = ctx->binary_semaphores.back();
-        ctx->binary_semaphores.pop_back();
+        *p_semaphore = state->binary_semaphores.back();
+        state->binary_semaphores.pop_back();
+    }
+
+    return VK_SUCCESS;
+}
+
+static
+void vkwsi_return_binary_semaphore(vkwsi_queue_state* state, VkSemaphore semaphore)
+{
+    state->binary_semaphores.emplace_back(semaphore);
+}
+
+static
+VkResult vkwsi_get_present_semaphore(vkwsi_context* ctx, vkwsi_queue_state* state, vkwsi_present_semaphore** p_semaphore)
+{
+    VkResult res;
+
+    if (!state->free_present_semaphores) {
+        // Take everything released from other threads in one go. Pushes can race with this, but not pops, so there is
+        // no ABA hazard.
+        state->free_present_semaphores = state->released_present_semaphores.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    if (auto present_semaphore = state->free_present_semaphores) {
+        state->free_present_semaphores = present_semaphore->next;
+        *p_semaphore = present_semaphore;
+        return VK_SUCCESS;
+    }
+
+    auto present_semaphore = vkwsi_new<vkwsi_present_semaphore>(ctx->alloc, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!present_semaphore) return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    res = vkwsi_create_binary_semaphore(ctx, &present_semaphore->semaphore);
+    if (res != VK_SUCCESS) {
+        vkwsi_delete(ctx->alloc, present_semaphore);
+        return res;
     }
 
+    present_semaphore->owner = state;
+    state->present_semaphores.emplace_back(present_semaphore);
+
+    *p_semaphore = present_semaphore;
+
     return VK_SUCCESS;
 }
 
 static
-void vkwsi_return_binary_semaphore(vkwsi_context* ctx, VkSemaphore semaphore)
+void vkwsi_release_present_semaphore(vkwsi_present_semaphore* present_semaphore)
 {
-    ctx->binary_semaphores.emplace_back(semaphore);
+    if (present_semaphore->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    auto& released = present_semaphore->owner->released_present_semaphores;
+    present_semaphore->next = released.load(std::memory_order_relaxed);
+    while (!released.compare_exchange_weak(present_semaphore->next, present_semaphore,
+            std::memory_order_release, std::memory_order_relaxed));
 }
 
 static
-VkResult vkwsi_recover_binary_semaphores(vkwsi_context* ctx)
+VkResult vkwsi_recover_binary_semaphores(vkwsi_context* ctx, vkwsi_queue_state* state)
 {
     VkResult res;
 
-    if (!ctx->acquire_resource_release_queue.empty()) {
+    if (!state->acquire_resource_release_queue.empty()) {
         uint64_t current_timeline_value = 0;
-        res = ctx->GetSemaphoreCounterValue(ctx->device, ctx->timeline, &current_timeline_value);
+        res = ctx->GetSemaphoreCounterValue(ctx->device, state->timeline, &current_timeline_value);
         VKWSI_CHECK(res);
 
-        while (!ctx->acquire_resource_release_queue.empty()) {
-            auto& head = ctx->acquire_resource_release_queue.front();
+        while (!state->acquire_resource_release_queue.empty()) {
+            auto& head = state->acquire_resource_release_queue.front();
 
             if (current_timeline_value >= head.timeline_value) {
                 for (auto& sema : head.semaphores) {
-                    vkwsi_return_binary_semaphore(ctx, sema);
+                    vkwsi_return_binary_semaphore(state, sema);
                 }
-                ctx->acquire_resource_release_queue.pop_front();
+                state->acquire_resource_release_queue.pop_front();
             } else {
                 break;
             }
@@ -307,95 +627,509 @@ VkResult vkwsi_recover_binary_semaphores(vkwsi_context* ctx)
 }
 
 static
-VkResult vkwsi_on_swapchain_present_complete(vkwsi_swapchain* swapchain, uint32_t idx)
+VkResult vkwsi_update_retired(vkwsi_swapchain* swapchain)
 {
     auto ctx = swapchain->ctx;
     VkResult res;
 
-    auto& fence = swapchain->resources[idx].present_signal_fence;
-    if (fence) {
-        res = vkwsi_return_fence(ctx, fence);
-        VKWSI_CHECK(res);
-        fence = nullptr;
+    // NOTE: Presents can retire out of order (e.g. MAILBOX discards), the counter only advances up to the oldest
+    //       present that is still outstanding.
+    uint64_t retired = swapchain->present_serial;
+    for (auto& resources : swapchain->resources) {
+        if (resources.present_signal_fence) retired = std::min(retired, resources.present_serial - 1);
     }
-
-    auto& sema = swapchain->resources[idx].last_present_wait_semaphore;
-    if (sema) {
-        if (!--ctx->present_semaphore_release_map.at(sema)) {
-            vkwsi_return_binary_semaphore(ctx, sema);
-            ctx->present_semaphore_release_map.erase(sema);
+    for (auto& old : swapchain->retired_swapchains) {
+        for (auto& resources : old.resources) {
+            if (resources.present_signal_fence) retired = std::min(retired, resources.present_serial - 1);
         }
-        sema = nullptr;
+    }
+    for (auto& present : swapchain->shared_presents) {
+        retired = std::min(retired, present.serial - 1);
+    }
+
+    if (retired <= swapchain->retired_serial) return VK_SUCCESS;
+    swapchain->retired_serial = retired;
+
+    if (swapchain->retire_timeline) {
+        res = ctx->SignalSemaphore(ctx->device, vkwsi_temp(VkSemaphoreSignalInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+            .semaphore = swapchain->retire_timeline,
+            .value = retired,
+        }));
+        VKWSI_CHECK(res);
     }
 
     return VK_SUCCESS;
 }
 
 static
-VkResult vkwsi_wait_for_present_complete(vkwsi_swapchain* swapchain, uint32_t present_index)
+void vkwsi_add_timing_sample(vkwsi_swapchain* swapchain, std::chrono::steady_clock::time_point time)
 {
-    auto ctx = swapchain->ctx;
-    VkResult res;
+    auto& timing = swapchain->timing;
 
-    auto& fence = swapchain->resources[present_index].present_signal_fence;
-    if (!fence) {
-        return VK_SUCCESS;
+    timing.samples[timing.head] = time;
+    timing.head = (timing.head + 1) % VKWSI_TIMING_SAMPLES;
+    timing.count = std::min(timing.count + 1, uint32_t(VKWSI_TIMING_SAMPLES));
+    if (timing.count < VKWSI_TIMING_MIN_SAMPLES) return;
+
+    // Sample times in nanoseconds relative to the newest, oldest first
+
+    double t[VKWSI_TIMING_SAMPLES];
+    for (uint32_t i = 0; i < timing.count; ++i) {
+        auto sample = timing.samples[(timing.head + VKWSI_TIMING_SAMPLES - timing.count + i) % VKWSI_TIMING_SAMPLES];
+        t[i] = std::chrono::duration<double, std::nano>(sample - time).count();
     }
 
-    res = ctx->WaitForFences(ctx->device, 1, &fence, true, UINT64_MAX);
-    VKWSI_CHECK(res);
+    // NOTE: Timed presents are mostly shown on consecutive refreshes, so the median gap between two completions is a
+    //       first estimate of the interval that holds up against jitter and the odd missed refresh. Gaps under a
+    //       millisecond are completions observed after the same refresh.
 
-    vkwsi_on_swapchain_present_complete(swapchain, present_index);
+    constexpr double min_interval = 1e6;
+    double gaps[VKWSI_TIMING_SAMPLES];
+    uint32_t gap_count = 0;
+    for (uint32_t i = 1; i < timing.count; ++i) {
+        double gap = t[i] - t[i - 1];
+        if (gap >= min_interval) gaps[gap_count++] = gap;
+    }
+    if (gap_count == 0) return;
+
+    std::nth_element(gaps, gaps + gap_count / 2, gaps + gap_count);
+    double interval = gaps[gap_count / 2];
+
+    // Assign every sample to its nearest refresh on the current grid, and least squares fit the grid to them. The
+    // second pass reassigns samples against the corrected interval, which removes most of the jitter in the first guess.
+
+    double phase = 0;
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+        double sum_n = 0, sum_t = 0, sum_nn = 0, sum_nt = 0;
+        for (uint32_t i = 0; i < timing.count; ++i) {
+            double n = std::round((t[i] - phase) / interval);
+            sum_n += n;
+            sum_t += t[i];
+            sum_nn += n * n;
+            sum_nt += n * t[i];
+        }
 
-    return VK_SUCCESS;
+        double count = timing.count;
+        double variance = count * sum_nn - sum_n * sum_n;
+        if (variance <= 0) return;
+
+        interval = (count * sum_nt - sum_n * sum_t) / variance;
+        phase = (sum_t - interval * sum_n) / count;
+        if (interval < min_interval) return;
+    }
+
+    timing.refresh_interval = std::chrono::nanoseconds(std::llround(interval));
+    timing.refresh_phase = time + std::chrono::nanoseconds(std::llround(phase));
 }
 
+// Time until which a present that should not be shown before `desired_ns` is held on the host, when the desired time
+// can't be passed on to the presentation engine. Never more than VKWSI_MAX_PRESENT_HOLD_MS from now.
 static
-VkResult vkwsi_wait_all_present_complete(vkwsi_swapchain* swapchain)
+std::chrono::steady_clock::time_point vkwsi_present_hold_time(vkwsi_swapchain* swapchain, uint64_t desired_ns)
 {
-    VkResult res;
+    auto& timing = swapchain->timing;
+    auto desired = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(desired_ns));
+
+    auto hold_until = desired;
+    if (vkwsi_is_timed_present_mode(swapchain->info.present_mode) && timing.refresh_interval.count()
+            && desired > timing.refresh_phase) {
+        // NOTE: FIFO presents are shown on the first refresh after they are issued. Issue the present half an interval
+        //       before the first refresh at or after the desired time, which leaves room for scheduling jitter either way.
+        auto interval = timing.refresh_interval;
+        auto refreshes = (desired - timing.refresh_phase + interval - std::chrono::nanoseconds(1)) / interval;
+        hold_until = timing.refresh_phase + interval * refreshes - interval / 2;
+    }
 
-    for (uint32_t i = 0; i < swapchain->resources.size(); ++i) {
-        res = vkwsi_wait_for_present_complete(swapchain, i);
-        VKWSI_CHECK(res);
+    // NOTE: A desired time far in the future is most likely from the wrong time base, don't stall the present on it
+    auto max_hold_until = std::chrono::steady_clock::now() + std::chrono::milliseconds(VKWSI_MAX_PRESENT_HOLD_MS);
+    if (hold_until > max_hold_until) {
+        VKWSI_LOG(swapchain->ctx, vkwsi_log_level_warn, "Desired present time is {} ms away, holding present for {} ms",
+            std::chrono::duration_cast<std::chrono::milliseconds>(desired - std::chrono::steady_clock::now()).count(),
+            VKWSI_MAX_PRESENT_HOLD_MS);
+        hold_until = max_hold_until;
     }
 
-    return VK_SUCCESS;
+    return hold_until;
 }
 
-// -----------------------------------------------------------------------------
-
-VkResult vkwsi_swapchain_create(vkwsi_swapchain** pp_swapchain, vkwsi_context* ctx, VkSurfaceKHR surface)
+static
+void vkwsi_destroy_user_data(vkwsi_swapchain* swapchain, vkwsi_swapchain_per_image_resources& resources)
 {
-    VkResult res;
-
-    auto swapchain = new vkwsi_swapchain {};
-
-    swapchain->ctx = ctx;
-    swapchain->surface = surface;
-    swapchain->out_of_date = true;
-
-    *pp_swapchain = swapchain;
-
-    return VK_SUCCESS;
+    auto& callbacks = resources.user_data_callbacks;
+    if (resources.user_data && callbacks.destroy) {
+        callbacks.destroy(callbacks.data, swapchain, resources.user_data);
+    }
+    resources.user_data = nullptr;
+    resources.user_data_stale = false;
 }
 
-void vkwsi_swapchain_set_info(vkwsi_swapchain* swapchain, const vkwsi_swapchain_info* info)
+static
+bool vkwsi_is_acquired_image(vkwsi_swapchain* swapchain, const vkwsi_swapchain_per_image_resources& resources)
 {
-    swapchain->pending_info = *info;
-    swapchain->out_of_date = true;
+    return swapchain->acquired && swapchain->image_index < swapchain->resources.size()
+        && &swapchain->resources[swapchain->image_index] == &resources;
 }
 
+// Called once the last present of an image has completed, `resources` may belong to a retired swapchain
 static
-void vkwsi_destroy_vk_swapchain(vkwsi_swapchain* swapchain)
+VkResult vkwsi_on_present_complete(vkwsi_swapchain* swapchain, vkwsi_swapchain_per_image_resources& resources)
 {
-    auto ctx = swapchain->ctx;
+    VkResult res;
 
-    for (auto& res : swapchain->resources) {
-        ctx->DestroyImageView(ctx->device, res.view, ctx->alloc);
+    auto& fence = resources.present_signal_fence;
+    if (fence) {
+        res = vkwsi_return_fence(swapchain, fence);
+        VKWSI_CHECK(res);
+        fence = nullptr;
     }
 
-    ctx->DestroySwapchainKHR(ctx->device, swapchain->swapchain, ctx->alloc);
+    auto& sema = resources.present_wait_semaphore;
+    if (sema) {
+        vkwsi_release_present_semaphore(sema);
+        sema = nullptr;
+    }
+
+    // NOTE: The acquired image's user data is replaced by acquire instead, which may still be handing it out
+    if (resources.user_data_stale && !vkwsi_is_acquired_image(swapchain, resources)) {
+        vkwsi_destroy_user_data(swapchain, resources);
+    }
+
+    return vkwsi_update_retired(swapchain);
+}
+
+static
+VkResult vkwsi_wait_for_present_complete(vkwsi_swapchain* swapchain, uint32_t present_index)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    auto& fence = swapchain->resources[present_index].present_signal_fence;
+    if (!fence) {
+        return VK_SUCCESS;
+    }
+
+    // NOTE: A present can only be timed if we actually block on it, if it had already completed it could have done so
+    //       at any point since it was issued.
+    bool timed = vkwsi_is_timed_present_mode(swapchain->info.present_mode) && !swapchain->out_of_date;
+    auto wait_start = std::chrono::steady_clock::now();
+
+    if (timed && ctx->present_wait) {
+        // NOTE: The present fence may signal as soon as the presentation engine has taken the image, whereas present
+        //       waits complete once it is shown. Errors (e.g. OUT-OF-DATE) and timeouts just fall back to the fence.
+        res = ctx->WaitForPresentKHR(ctx->device, swapchain->swapchain,
+            swapchain->resources[present_index].present_serial, ctx->host_wait_timeout);
+        auto now = std::chrono::steady_clock::now();
+        if (res == VK_SUCCESS && now - wait_start >= std::chrono::microseconds(VKWSI_TIMING_MIN_WAIT_US)) {
+            vkwsi_add_timing_sample(swapchain, now);
+            if (!ctx->display_timing) swapchain->resources[present_index].present_time = now;
+        }
+        timed = false;
+    }
+
+    res = ctx->WaitForFences(ctx->device, 1, &fence, true, UINT64_MAX);
+    VKWSI_CHECK(res);
+
+    if (timed) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - wait_start >= std::chrono::microseconds(VKWSI_TIMING_MIN_WAIT_US)) {
+            vkwsi_add_timing_sample(swapchain, now);
+        }
+    }
+
+    return vkwsi_on_present_complete(swapchain, swapchain->resources[present_index]);
+}
+
+static
+VkResult vkwsi_poll_present_complete(vkwsi_swapchain* swapchain, uint32_t present_index, bool* p_complete)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    auto fence = swapchain->resources[present_index].present_signal_fence;
+    if (!fence) {
+        *p_complete = true;
+        return VK_SUCCESS;
+    }
+
+    res = ctx->GetFenceStatus(ctx->device, fence);
+    if (res == VK_NOT_READY) {
+        *p_complete = false;
+        return VK_SUCCESS;
+    }
+    VKWSI_CHECK(res);
+
+    *p_complete = true;
+    return vkwsi_on_present_complete(swapchain, swapchain->resources[present_index]);
+}
+
+// Recycles the fences and semaphores of superseded shared image presents once they have completed, waiting for them if
+// `wait` is set. Stops at the oldest present still outstanding.
+static
+VkResult vkwsi_collect_shared_presents(vkwsi_swapchain* swapchain, bool wait)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    auto& presents = swapchain->shared_presents;
+    if (presents.empty()) return VK_SUCCESS;
+
+    while (!presents.empty()) {
+        auto present = presents.front();
+
+        res = wait
+            ? ctx->WaitForFences(ctx->device, 1, &present.fence, true, UINT64_MAX)
+            : ctx->GetFenceStatus(ctx->device, present.fence);
+        if (res == VK_NOT_READY) break;
+        VKWSI_CHECK(res);
+
+        presents.erase(presents.begin());
+        res = vkwsi_return_fence(swapchain, present.fence);
+        VKWSI_CHECK(res);
+        if (present.semaphore) vkwsi_release_present_semaphore(present.semaphore);
+    }
+
+    return vkwsi_update_retired(swapchain);
+}
+
+// Reads back when presents were actually shown (VK_GOOGLE_display_timing). Presents are matched to images by the
+// present ID they were given, which is their present serial.
+static
+VkResult vkwsi_read_past_presentation_timing(vkwsi_swapchain* swapchain)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    if (!ctx->display_timing) return VK_SUCCESS;
+
+    auto& timings = swapchain->past_timings;
+    if (ctx->async_present) {
+        std::scoped_lock lock { swapchain->vk_mutex };
+        res = vkwsi_enumerate(timings, ctx->GetPastPresentationTimingGOOGLE, ctx->device, swapchain->swapchain);
+    } else {
+        res = vkwsi_enumerate(timings, ctx->GetPastPresentationTimingGOOGLE, ctx->device, swapchain->swapchain);
+    }
+    // NOTE: Feedback is best effort, OUT-OF-DATE swapchains will be recreated by the next acquire anyway
+    if (res == VK_ERROR_OUT_OF_DATE_KHR) return VK_SUCCESS;
+    VKWSI_CHECK(res);
+
+    for (auto& timing : timings) {
+        for (auto& resources : swapchain->resources) {
+            if (uint32_t(resources.present_serial) != timing.presentID) continue;
+            resources.present_time = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(timing.actualPresentTime));
+            break;
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+static
+VkResult vkwsi_wait_all_present_complete(vkwsi_swapchain* swapchain)
+{
+    VkResult res;
+
+    res = vkwsi_collect_shared_presents(swapchain, true);
+    VKWSI_CHECK(res);
+
+    for (uint32_t i = 0; i < swapchain->resources.size(); ++i) {
+        res = vkwsi_wait_for_present_complete(swapchain, i);
+        VKWSI_CHECK(res);
+    }
+
+    return VK_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+
+VkResult vkwsi_swapchain_create(vkwsi_swapchain** pp_swapchain, vkwsi_context* ctx, VkSurfaceKHR surface)
+{
+    VkResult res;
+
+    auto swapchain = vkwsi_new<vkwsi_swapchain>(ctx->alloc, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, ctx);
+    if (!swapchain) return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    swapchain->surface = surface;
+    swapchain->out_of_date = true;
+
+    if (ctx->recorder) vkwsi_record_swapchain(swapchain, vkwsi_record_type_swapchain_create);
+
+    *pp_swapchain = swapchain;
+
+    return VK_SUCCESS;
+}
+
+VkResult vkwsi_swapchain_create_headless(vkwsi_swapchain** pp_swapchain, vkwsi_context* ctx)
+{
+    VkResult res;
+
+    if (!ctx->CreateHeadlessSurfaceEXT) {
+        VKWSI_LOG(ctx, vkwsi_log_level_error, "Headless swapchains require VK_EXT_headless_surface");
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkSurfaceKHR surface;
+    res = ctx->CreateHeadlessSurfaceEXT(ctx->instance, vkwsi_temp(VkHeadlessSurfaceCreateInfoEXT {
+        .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+    }), ctx->alloc, &surface);
+    VKWSI_CHECK(res);
+
+    res = vkwsi_swapchain_create(pp_swapchain, ctx, surface);
+    if (res != VK_SUCCESS) {
+        ctx->DestroySurfaceKHR(ctx->instance, surface, ctx->alloc);
+        return res;
+    }
+
+    (*pp_swapchain)->owns_surface = true;
+
+    return VK_SUCCESS;
+}
+
+static
+bool vkwsi_is_compatible_present_mode(vkwsi_swapchain* swapchain, VkPresentModeKHR present_mode)
+{
+    return std::ranges::find(swapchain->compatible_present_modes, present_mode) != swapchain->compatible_present_modes.end();
+}
+
+static
+void vkwsi_apply_info(vkwsi_swapchain* swapchain, const vkwsi_swapchain_info& info)
+{
+    swapchain->pending_info = info;
+
+    // NOTE: Switching between compatible present modes doesn't require recreating the swapchain,
+    //       the new present mode is passed to the next present with VkSwapchainPresentModeInfoEXT.
+    //       Compatibility is relative to the live swapchain, not to any info still pending.
+    auto created = swapchain->created_info;
+    created.present_mode = info.present_mode;
+    if (swapchain->swapchain
+            && created == info
+            && vkwsi_is_compatible_present_mode(swapchain, info.present_mode)) {
+        // NOTE: Presents of another mode aren't paced on the same grid, if they are timed at all
+        if (swapchain->info.present_mode != info.present_mode) swapchain->timing = {};
+        swapchain->info.present_mode = info.present_mode;
+        return;
+    }
+
+    swapchain->adaptive_extra_images = 0;
+    swapchain->adaptive_stats = {};
+    swapchain->out_of_date = true;
+}
+
+void vkwsi_swapchain_set_info(vkwsi_swapchain* swapchain, const vkwsi_swapchain_info* info)
+{
+    auto ctx = swapchain->ctx;
+
+    if (ctx->recorder) vkwsi_record_swapchain(swapchain, vkwsi_record_type_swapchain_set_info, info);
+
+    auto box = vkwsi_new<vkwsi_swapchain_info>(ctx->alloc, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, *info);
+    if (!box) {
+        VKWSI_LOG(ctx, vkwsi_log_level_error, "Failed to allocate swapchain info update");
+        return;
+    }
+
+    // Replace any update that acquire hasn't consumed yet
+    vkwsi_delete(ctx->alloc, swapchain->mailbox_info.exchange(box, std::memory_order_acq_rel));
+}
+
+// Consumes updates posted by `vkwsi_swapchain_resize` and `vkwsi_swapchain_set_info`
+static
+void vkwsi_read_mailbox(vkwsi_swapchain* swapchain)
+{
+    auto packed = swapchain->mailbox_extent.load(std::memory_order_relaxed);
+    VkExtent2D extent { uint32_t(packed >> 32), uint32_t(packed) };
+    if (extent != swapchain->pending_extent) {
+        // Try again immediately
+        swapchain->parked = false;
+        swapchain->pending_extent = extent;
+    }
+
+    if (swapchain->mailbox_info.load(std::memory_order_relaxed)) {
+        if (auto box = swapchain->mailbox_info.exchange(nullptr, std::memory_order_acquire)) {
+            vkwsi_apply_info(swapchain, *box);
+            vkwsi_delete(swapchain->ctx->alloc, box);
+        }
+    }
+}
+
+// NOTE: Must only be called once all presents to the images have completed
+static
+void vkwsi_destroy_image_resources(
+    vkwsi_swapchain* swapchain,
+    std::span<vkwsi_swapchain_per_image_resources> resources, VkCommandPool transition_pool)
+{
+    auto ctx = swapchain->ctx;
+
+    for (auto& res : resources) {
+        vkwsi_destroy_user_data(swapchain, res);
+        ctx->DestroyImageView(ctx->device, res.view, ctx->alloc);
+    }
+
+    // NOTE: Frees all transition command buffers along with it
+    ctx->DestroyCommandPool(ctx->device, transition_pool, ctx->alloc);
+}
+
+// Destroys retired swapchains once their presents have completed, waiting for them if `wait` is set
+static
+VkResult vkwsi_collect_retired_swapchains(vkwsi_swapchain* swapchain, bool wait)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    auto& retired = swapchain->retired_swapchains;
+    for (auto iter = retired.begin(); iter != retired.end();) {
+        bool complete = true;
+        for (auto& resources : iter->resources) {
+            if (!resources.present_signal_fence) continue;
+
+            res = wait
+                ? ctx->WaitForFences(ctx->device, 1, &resources.present_signal_fence, true, UINT64_MAX)
+                : ctx->GetFenceStatus(ctx->device, resources.present_signal_fence);
+            if (res == VK_NOT_READY) {
+                complete = false;
+                continue;
+            }
+            VKWSI_CHECK(res);
+
+            res = vkwsi_on_present_complete(swapchain, resources);
+            VKWSI_CHECK(res);
+        }
+
+        if (!complete) {
+            ++iter;
+            continue;
+        }
+
+        vkwsi_destroy_image_resources(swapchain, iter->resources, iter->transition_pool);
+        ctx->DestroySwapchainKHR(ctx->device, iter->swapchain, ctx->alloc);
+        iter = retired.erase(iter);
+    }
+
+    return VK_SUCCESS;
+}
+
+// Moves the current swapchain to `retired_swapchains` after it has been replaced, see `vkwsi_retired_swapchain`
+static
+void vkwsi_retire_vk_swapchain(vkwsi_swapchain* swapchain)
+{
+    swapchain->retired_swapchains.push_back({
+        .swapchain = std::exchange(swapchain->swapchain, nullptr),
+        .transition_pool = std::exchange(swapchain->transition_pool, nullptr),
+        .resources = std::move(swapchain->resources),
+    });
+    swapchain->resources.clear();
+    swapchain->shared_acquired = false;
+}
+
+static
+void vkwsi_destroy_vk_swapchain(vkwsi_swapchain* swapchain)
+{
+    auto ctx = swapchain->ctx;
+
+    vkwsi_destroy_image_resources(swapchain, swapchain->resources, swapchain->transition_pool);
+    swapchain->transition_pool = nullptr;
+
+    ctx->DestroySwapchainKHR(ctx->device, swapchain->swapchain, ctx->alloc);
+    swapchain->shared_acquired = false;
 }
 
 void vkwsi_swapchain_destroy(vkwsi_swapchain* swapchain)
@@ -404,11 +1138,29 @@ void vkwsi_swapchain_destroy(vkwsi_swapchain* swapchain)
     //       Destroy operations should not be able to fail. Should we make "wait for all presents" public
     //       and make it an API contract violation (with an assert) to attempt to destroy the swapchain
     //       without first waiting?
+    if (swapchain->ctx->recorder) vkwsi_record_swapchain(swapchain, vkwsi_record_type_swapchain_destroy);
+
+    vkwsi_wait_queued_presents(swapchain, 0);
     vkwsi_wait_all_present_complete(swapchain);
+    vkwsi_collect_retired_swapchains(swapchain, true);
 
     vkwsi_destroy_vk_swapchain(swapchain);
 
-    delete swapchain;
+    vkwsi_delete(swapchain->ctx->alloc, swapchain->mailbox_info.load());
+
+    for (auto fence : swapchain->fences) {
+        swapchain->ctx->DestroyFence(swapchain->ctx->device, fence, swapchain->ctx->alloc);
+    }
+
+    if (swapchain->retire_timeline) {
+        swapchain->ctx->DestroySemaphore(swapchain->ctx->device, swapchain->retire_timeline, swapchain->ctx->alloc);
+    }
+
+    if (swapchain->owns_surface) {
+        swapchain->ctx->DestroySurfaceKHR(swapchain->ctx->instance, swapchain->surface, swapchain->ctx->alloc);
+    }
+
+    vkwsi_delete(swapchain->ctx->alloc, swapchain);
 }
 
 static
@@ -417,13 +1169,27 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
     auto ctx = swapchain->ctx;
     VkResult res;
 
-    vkwsi_wait_all_present_complete(swapchain);
+    // NOTE: Presents still queued on the present thread reference the current swapchain handle. Presents that have
+    //       been issued don't need to complete, the old swapchain is retired and destroyed once they have.
+    vkwsi_wait_queued_presents(swapchain, 0);
+
+    // NOTE: Superseded shared image presents aren't tracked by the retired swapchain, so must complete before it is
+    res = vkwsi_collect_shared_presents(swapchain, true);
+    VKWSI_CHECK(res);
 
     auto info = swapchain->pending_info;
     auto desired_extent = swapchain->pending_extent;
 
+    bool shared = vkwsi_is_shared_present_mode(info.present_mode);
+
+    // NOTE: Only valid in the chain with VK_KHR_shared_presentable_image enabled, which shared modes require
+    VkSharedPresentSurfaceCapabilitiesKHR shared_caps {
+        .sType = VK_STRUCTURE_TYPE_SHARED_PRESENT_SURFACE_CAPABILITIES_KHR,
+    };
+
     VkSurfacePresentScalingCapabilitiesEXT scaling_caps {
         .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_SCALING_CAPABILITIES_EXT,
+        .pNext = shared ? &shared_caps : nullptr,
     };
 
     VkSurfaceCapabilities2KHR caps {
@@ -431,7 +1197,7 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
         .pNext = &scaling_caps,
     };
 
-    res = ctx->GetPhysicalDeviceSurfaceCapabilities2KHR(ctx->physical_device, vkwsi_temp(VkPhysicalDeviceSurfaceInfo2KHR {
+    res = vkwsi_driver_get_surface_capabilities(ctx, vkwsi_temp(VkPhysicalDeviceSurfaceInfo2KHR {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR,
         .pNext = vkwsi_temp(VkSurfacePresentModeKHR {
             .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_KHR,
@@ -443,6 +1209,84 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
 
     auto& surface_caps = caps.surfaceCapabilities;
 
+    if (ctx->recorder && surface_caps.currentExtent.width != 0xFFFFFFFF) {
+        vkwsi_record_driver_surface_extent(swapchain, surface_caps.currentExtent);
+    }
+
+    if (surface_caps.maxImageExtent.width == 0 || surface_caps.maxImageExtent.height == 0
+            || surface_caps.currentExtent.width == 0 || surface_caps.currentExtent.height == 0) {
+        // NOTE: Some platforms report a zero extent while minimized, no swapchain can be created for the surface
+        VKWSI_LOG(ctx, vkwsi_log_level_trace, "Surface has zero extent, not presentable");
+        return VK_NOT_READY;
+    }
+
+    // Query present modes that can be switched to without recreating the swapchain
+
+    vkwsi_vector<VkPresentModeKHR> present_modes { ctx->alloc };
+    VkSurfacePresentModeCompatibilityEXT present_mode_compat {
+        .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_COMPATIBILITY_EXT,
+    };
+    // NOTE: The first query returns the count and the second fills in the modes, unless there are none to fill in
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+        res = vkwsi_driver_get_surface_capabilities(ctx, vkwsi_temp(VkPhysicalDeviceSurfaceInfo2KHR {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR,
+            .pNext = vkwsi_temp(VkSurfacePresentModeKHR {
+                .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_KHR,
+                .presentMode = info.present_mode,
+            }),
+            .surface = swapchain->surface,
+        }), vkwsi_temp(VkSurfaceCapabilities2KHR {
+            .sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR,
+            .pNext = &present_mode_compat,
+        }));
+        VKWSI_CHECK(res);
+
+        if (pass > 0 || present_mode_compat.presentModeCount == 0) break;
+
+        present_modes.resize(present_mode_compat.presentModeCount);
+        present_mode_compat.pPresentModes = present_modes.data();
+    }
+    present_modes.resize(present_mode_compat.presentModeCount);
+    if (std::ranges::find(present_modes, info.present_mode) == present_modes.end()) {
+        present_modes.push_back(info.present_mode);
+    }
+
+    // NOTE: The swapchain must have at least as many images as any of its present modes requires, which may be more
+    //       than `info.present_mode` does. Modes that need more images than the surface allows are dropped instead.
+    auto max_image_count = shared ? 1u : surface_caps.maxImageCount;
+    uint32_t modes_min_image_count = surface_caps.minImageCount;
+    for (uint32_t i = 0; i < present_modes.size();) {
+        auto present_mode = present_modes[i];
+        if (present_mode == info.present_mode) {
+            ++i;
+            continue;
+        }
+
+        VkSurfaceCapabilities2KHR mode_caps {
+            .sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR,
+        };
+        res = vkwsi_driver_get_surface_capabilities(ctx, vkwsi_temp(VkPhysicalDeviceSurfaceInfo2KHR {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR,
+            .pNext = vkwsi_temp(VkSurfacePresentModeKHR {
+                .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_KHR,
+                .presentMode = present_mode,
+            }),
+            .surface = swapchain->surface,
+        }), &mode_caps);
+        VKWSI_CHECK(res);
+
+        auto mode_min_image_count = mode_caps.surfaceCapabilities.minImageCount;
+        if (max_image_count && mode_min_image_count > max_image_count) {
+            VKWSI_LOG(ctx, vkwsi_log_level_trace, "Present mode {} requires {} images, more than the surface allows ({}), dropping",
+                int(present_mode), mode_min_image_count, max_image_count);
+            present_modes.erase(present_modes.begin() + i);
+            continue;
+        }
+
+        modes_min_image_count = std::max(modes_min_image_count, mode_min_image_count);
+        ++i;
+    }
+
 #if VKWSI_NOISY_SWAPCHAIN_CREATION
     VKWSI_LOG(ctx, vkwsi_log_level_trace, "Recreating swapchain");
     VKWSI_LOG(ctx, vkwsi_log_level_trace, "        min_extent = ({:5}, {:5})", surface_caps.minImageExtent.width, surface_caps.minImageExtent.height);
@@ -460,8 +1304,27 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
         .height = std::clamp(desired_extent.height, surface_caps.minImageExtent.height, surface_caps.maxImageExtent.height),
     };
 
+    constexpr VkPresentScalingFlagsKHR stretch_scaling = VK_PRESENT_SCALING_ASPECT_RATIO_STRETCH_BIT_EXT | VK_PRESENT_SCALING_STRETCH_BIT_EXT;
+    auto source_extent = swapchain->source_extent;
+    bool source_scaled = false;
+
     VkPresentScalingFlagsKHR scaling_mode = {};
-    if (scaling_caps.supportedPresentScaling) {
+    if ((scaling_caps.supportedPresentScaling & stretch_scaling) && source_extent.width && source_extent.height
+            && source_extent.width >= scaling_caps.minScaledImageExtent.width
+            && source_extent.height >= scaling_caps.minScaledImageExtent.height
+            && source_extent.width <= scaling_caps.maxScaledImageExtent.width
+            && source_extent.height <= scaling_caps.maxScaledImageExtent.height) {
+        // NOTE: Presented from a source image (see `vkwsi_swapchain_present_image`), let the presentation engine
+        //       stretch it to the window. The blit is then a plain copy, and the swapchain survives window resizes.
+        scaling_mode = (scaling_caps.supportedPresentScaling & VK_PRESENT_SCALING_ASPECT_RATIO_STRETCH_BIT_EXT)
+            ? VK_PRESENT_SCALING_ASPECT_RATIO_STRETCH_BIT_EXT
+            : VK_PRESENT_SCALING_STRETCH_BIT_EXT;
+        extent = source_extent;
+        source_scaled = true;
+#if VKWSI_NOISY_SWAPCHAIN_CREATION
+        VKWSI_LOG(ctx, vkwsi_log_level_trace, "      scaling_mode = {} (from source)", scaling_mode);
+#endif
+    } else if (scaling_caps.supportedPresentScaling) {
         auto min = scaling_caps.minScaledImageExtent;
         auto max = scaling_caps.maxScaledImageExtent;
 #if VKWSI_NOISY_SWAPCHAIN_CREATION
@@ -511,12 +1374,25 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
     } else {
         VKWSI_LOG(ctx, vkwsi_log_level_trace, "  caps_image_count = ({}..)", surface_caps.minImageCount);
     }
-    VKWSI_LOG(ctx, vkwsi_log_level_trace, "   min_image_count =  {}", info.min_image_count);
+    VKWSI_LOG(ctx, vkwsi_log_level_trace, "   min_image_count =  {} + {}", info.min_image_count, swapchain->adaptive_extra_images);
 #endif
 
-    auto min_image_count = std::max(info.min_image_count, surface_caps.minImageCount);
+    if (surface_caps.maxImageCount && info.min_image_count + swapchain->adaptive_extra_images > surface_caps.maxImageCount) {
+        // NOTE: Don't keep extra images the surface can't provide, or shrinking would take longer to have any effect
+        swapchain->adaptive_extra_images = surface_caps.maxImageCount - std::min(info.min_image_count, surface_caps.maxImageCount);
+    }
+
+    auto min_image_count = std::max(info.min_image_count + swapchain->adaptive_extra_images, modes_min_image_count);
     if (surface_caps.maxImageCount) min_image_count = std::min(min_image_count, surface_caps.maxImageCount);
 
+    if (shared) {
+        min_image_count = 1;
+        if (info.image_usage & ~shared_caps.sharedPresentSupportedUsageFlags) {
+            VKWSI_LOG(ctx, vkwsi_log_level_error, "Image usage {:#x} not supported for shared present modes (supported: {:#x})",
+                info.image_usage, shared_caps.sharedPresentSupportedUsageFlags);
+        }
+    }
+
 #if VKWSI_NOISY_SWAPCHAIN_CREATION
     VKWSI_LOG(ctx, vkwsi_log_level_trace, " final_image_count =  {}", min_image_count);
 #endif
@@ -531,15 +1407,22 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
     // NOTE: There is theoretically a race condition between querying surface capabitlies and creating the swapchain
     //       However, in practice, these appear to be resolved by drivers allowing the swapchain creation to occur and then
     //       returning VK_ERROR_OUT_OF_DATE_KHR from the first call to vkAcquireNextImageKHR.
+    swapchain->retired_swapchains.reserve(swapchain->retired_swapchains.size() + 1);
+
     VkSwapchainKHR new_swapchain = {};
-    res = ctx->CreateSwapchainKHR(ctx->device, vkwsi_temp(VkSwapchainCreateInfoKHR {
+    res = vkwsi_driver_create_swapchain(ctx, vkwsi_temp(VkSwapchainCreateInfoKHR {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-        .pNext = scaling_mode
-            ? vkwsi_temp(VkSwapchainPresentScalingCreateInfoEXT {
-                .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_SCALING_CREATE_INFO_EXT,
-                .scalingBehavior = scaling_mode,
-            })
-            : nullptr,
+        .pNext = vkwsi_temp(VkSwapchainPresentModesCreateInfoEXT {
+            .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODES_CREATE_INFO_EXT,
+            .pNext = scaling_mode
+                ? vkwsi_temp(VkSwapchainPresentScalingCreateInfoEXT {
+                    .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_SCALING_CREATE_INFO_EXT,
+                    .scalingBehavior = scaling_mode,
+                })
+                : nullptr,
+            .presentModeCount = uint32_t(present_modes.size()),
+            .pPresentModes = present_modes.data(),
+        }),
         // NOTE: Deferred allocation improves latency when recreating swapchains and reduces the likelihood
         //       of failing to acquire immediately after a resize.
         //       However, it can result in swapchain images being allocated individually, which may have *some* impact
@@ -559,15 +1442,15 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
         .compositeAlpha        = info.composite_alpha,
         .presentMode           = info.present_mode,
         .oldSwapchain          = swapchain->swapchain,
-    }), ctx->alloc, &new_swapchain);
+    }), &new_swapchain);
     VKWSI_CHECK(res);
 
     // Replace the swapchain
 
-    vkwsi_destroy_vk_swapchain(swapchain);
+    vkwsi_retire_vk_swapchain(swapchain);
     swapchain->swapchain = new_swapchain;
 
-    std::vector<VkImage> images;
+    vkwsi_vector<VkImage> images { ctx->alloc };
     vkwsi_enumerate(images, ctx->GetSwapchainImagesKHR, ctx->device, swapchain->swapchain);
 
     swapchain->resources.resize(images.size());
@@ -575,17 +1458,35 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
         swapchain->resources[i] = {
             .image = images[i],
             .view = nullptr,
-            .last_present_wait_semaphore = nullptr,
+            .present_wait_semaphore = nullptr,
+            .user_data = nullptr,
+            .user_data_callbacks = {},
+            .user_data_stale = false,
+            .acquire_cmd = nullptr,
+            .present_cmd = nullptr,
+            .blit_cmd = nullptr,
+            .blit_source = {},
+            .blit_serial = 0,
         };
     }
 
+    swapchain->acquired = false;
+    swapchain->compatible_present_modes = std::move(present_modes);
+    swapchain->acquire_headroom = uint32_t(images.size()) - std::min(modes_min_image_count, uint32_t(images.size()));
     swapchain->last_extent = extent;
+    swapchain->source_scaled = source_scaled;
+    swapchain->source_scaling_supported = scaling_caps.supportedPresentScaling & stretch_scaling;
     swapchain->out_of_date = false;
     swapchain->info = info;
     swapchain->info.min_image_count = min_image_count;
+    swapchain->created_info = info;
+    swapchain->max_image_count = surface_caps.maxImageCount;
     swapchain->version++;
 
-    if (extent != desired_extent) {
+    // NOTE: The new swapchain may be paced differently (e.g. moved to another display), so estimation starts over
+    swapchain->timing = {};
+
+    if (extent != desired_extent && !source_scaled) {
         VKWSI_LOG(ctx, vkwsi_log_level_warn, "Swapchain created but not with requested size. Actual: ({}, {}), requested: ({}, {})",
             extent.width, extent.height,
             desired_extent.width, desired_extent.height);
@@ -598,319 +1499,1676 @@ VkResult vkwsi_swapchain_recreate(vkwsi_swapchain* swapchain)
 
 VkResult vkwsi_swapchain_resize(vkwsi_swapchain* swapchain, VkExtent2D extent)
 {
-    // TODO: Should this function (or any) be thread safe?
+    if (swapchain->ctx->recorder) vkwsi_record_swapchain(swapchain, vkwsi_record_type_swapchain_resize, &extent);
 
-    swapchain->pending_extent = extent;
+    // NOTE: Only the latest extent matters, so resizes posted between acquires simply overwrite each other.
+    //       Acquire compares against the extent it last saw, and unparks the swapchain if it changed.
+    swapchain->mailbox_extent.store(uint64_t(extent.width) << 32 | extent.height, std::memory_order_relaxed);
 
     return VK_SUCCESS;
 }
 
-VkResult vkwsi_swapchain_acquire(
-    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
-    VkQueue adapter_queue,
-    const VkSemaphoreSubmitInfo* _signals, uint32_t _signal_count)
+static
+void vkwsi_update_adaptive_image_count(vkwsi_swapchain* swapchain, std::chrono::nanoseconds blocked)
 {
-    // NOTE: `adapter_queue` technically must be the same for all acquires. As signal operation ordering
-    //       guarantees are relied on for timeline correctness in the (pathological) case that separate
-    //       acquire calls complete out of orders
+    auto ctx = swapchain->ctx;
+    auto& stats = swapchain->adaptive_stats;
 
-    if (swapchain_count == 0) return VK_SUCCESS;
+    if (!swapchain->info.adaptive_image_count) return;
 
-    auto ctx = swapchains[0]->ctx;
-    VkResult res;
+    // NOTE: FIFO modes are throttled to the display rate by blocking in acquire, so time blocked there
+    //       is expected and says nothing about whether more images would help.
+    auto mode = swapchain->info.present_mode;
+    if (mode == VK_PRESENT_MODE_FIFO_KHR
+            || mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR
+            || mode == VK_PRESENT_MODE_FIFO_LATEST_READY_KHR) {
+        return;
+    }
 
-#if VKWSI_DEBUG_LINEARIZE
-        VkFence debug_fence = ctx->debug_fence;
-#else
-        VkFence debug_fence = nullptr;
-#endif
+    // NOTE: Shared present modes always use a single image
+    if (vkwsi_is_shared_present_mode(mode)) return;
 
-    // NOTE: We recovery acquire binary semaphores by polling the main context timeline semaphore
-    //       We could also avoid the additional poll by recovering binary semaphores via the appropriate
-    //       `vkwsi_on_swapchain_present_complete`, however this would force worst-case semaphore reuse.
-    vkwsi_recover_binary_semaphores(ctx);
+    if (blocked >= std::chrono::microseconds(VKWSI_ADAPTIVE_STALL_THRESHOLD_US)) {
+        stats.stalls++;
+    }
 
-    std::vector<VkSemaphoreSubmitInfo> wait_infos(swapchain_count);
-    for (uint32_t i = 0; i < swapchain_count; ++i) {
-        auto swapchain = swapchains[i];
+    if (++stats.frames < VKWSI_ADAPTIVE_WINDOW) return;
 
-        // TODO: How do we recover from errors that occur after we have successfully acquired from *some* swapchains
-        //       We need to ensure all swapchains are still in a recoverable state. (Wait and release swapchain images?)
+    auto image_count = uint32_t(swapchain->resources.size());
+    // NOTE: The surface's limit is authoritative, the fixed limit only bounds surfaces without one
+    auto max_image_count = swapchain->max_image_count ? swapchain->max_image_count : VKWSI_ADAPTIVE_MAX_IMAGE_COUNT;
 
-        uint32_t image_idx;
+    if (stats.stalls * VKWSI_ADAPTIVE_GROW_DIVISOR >= stats.frames) {
+        stats.idle_windows = 0;
+        if (image_count < max_image_count) {
+            VKWSI_LOG(ctx, vkwsi_log_level_info, "Acquire stalled in {}/{} frames, growing swapchain from {} images",
+                stats.stalls, stats.frames, image_count);
+            swapchain->adaptive_extra_images++;
+            swapchain->out_of_date = true;
+        }
+    } else if (stats.stalls == 0) {
+        // Shrink only after a sustained period without stalls, to avoid oscillating
+        if (++stats.idle_windows >= VKWSI_ADAPTIVE_SHRINK_WINDOWS && swapchain->adaptive_extra_images > 0) {
+            VKWSI_LOG(ctx, vkwsi_log_level_info, "No acquire stalls, shrinking swapchain from {} images", image_count);
+            swapchain->adaptive_extra_images--;
+            swapchain->out_of_date = true;
+            stats.idle_windows = 0;
+        }
+    } else {
+        stats.idle_windows = 0;
+    }
 
-        VkSemaphore wait_semaphore = nullptr;
-        res = vkwsi_get_binary_semaphore(ctx, &wait_semaphore);
+    stats.frames = 0;
+    stats.stalls = 0;
+}
+
+static
+void vkwsi_park_swapchain(vkwsi_swapchain* swapchain)
+{
+    auto ctx = swapchain->ctx;
+
+    if (!swapchain->parked) {
+        VKWSI_LOG(ctx, vkwsi_log_level_info, "Swapchain not presentable, parking");
+        swapchain->parked = true;
+        swapchain->park_backoff = std::chrono::milliseconds(VKWSI_PARK_BACKOFF_INITIAL_MS);
+    } else {
+        swapchain->park_backoff = std::min(swapchain->park_backoff * 2, std::chrono::nanoseconds(std::chrono::milliseconds(VKWSI_PARK_BACKOFF_MAX_MS)));
+    }
+
+    swapchain->park_retry_time = std::chrono::steady_clock::now() + swapchain->park_backoff;
+}
+
+// Begins recording `*p_cmd`, allocating it from the swapchain's transition pool if null
+static
+VkResult vkwsi_begin_image_commands(vkwsi_swapchain* swapchain, VkCommandBuffer* p_cmd)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    if (!swapchain->transition_pool) {
+        // NOTE: The family of a queue can't be queried from the queue itself, so it must be given by the application
+        if (!swapchain->info.queue_family_count) {
+            VKWSI_LOG(ctx, vkwsi_log_level_error, "Library recorded transitions and blits require the queue family in"
+                " vkwsi_swapchain_info::queue_families");
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
+        res = ctx->CreateCommandPool(ctx->device, vkwsi_temp(VkCommandPoolCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            // NOTE: Blits are re-recorded in place when their source changes
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = swapchain->info.queue_families[0],
+        }), ctx->alloc, &swapchain->transition_pool);
         VKWSI_CHECK(res);
-        res = ctx->SetDebugUtilsObjectNameEXT(ctx->device, vkwsi_temp(VkDebugUtilsObjectNameInfoEXT {
-            .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
-            .objectType = VK_OBJECT_TYPE_SEMAPHORE,
-            .objectHandle = uint64_t(wait_semaphore),
-            .pObjectName = "acquire-semaphore",
-        }));
+    }
+
+    if (!*p_cmd) {
+        res = ctx->AllocateCommandBuffers(ctx->device, vkwsi_temp(VkCommandBufferAllocateInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = swapchain->transition_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        }), p_cmd);
         VKWSI_CHECK(res);
+    }
 
-        wait_infos[i] = {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-            .semaphore = wait_semaphore,
-        };
+    res = ctx->BeginCommandBuffer(*p_cmd, vkwsi_temp(VkCommandBufferBeginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    }));
+    VKWSI_CHECK(res);
 
-        // TODO: Should this have a retry limit? This will only retry on OUT-OF-DATE errors, and those could be returned
-        //       an arbitrary number of times up until the user stops a resize operation.
+    return VK_SUCCESS;
+}
 
-        for (;;) {
-            bool check_caps = swapchain->pending_extent != swapchain->last_extent;
-            if (swapchain->out_of_date || check_caps) {
-                if (check_caps) {
-                    VKWSI_LOG(ctx, vkwsi_log_level_trace, "Desired/Actual mismatch ({}, {}) / ({}, {}), checking surface caps",
-                        swapchain->pending_extent.width, swapchain->pending_extent.height,
-                        swapchain->last_extent.width, swapchain->last_extent.height);
-                }
-                res = vkwsi_swapchain_recreate(swapchain);
-                VKWSI_CHECK(res);
-                if (swapchain->out_of_date) {
-                    VKWSI_LOG(ctx, vkwsi_log_level_warn, "Failed to recreate swapchain due to surface capabilities race, retrying...");
-                }
-            }
+// Records a single image layout transition into a new command buffer from the swapchain's transition pool
+static
+VkResult vkwsi_record_transition(
+    vkwsi_swapchain* swapchain, VkImage image,
+    VkImageLayout old_layout, VkImageLayout new_layout,
+    VkAccessFlags2 src_access, VkAccessFlags2 dst_access,
+    VkCommandBuffer* p_cmd)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
 
-            res = ctx->AcquireNextImageKHR(ctx->device, swapchain->swapchain, UINT64_MAX, wait_semaphore, debug_fence, &image_idx);
-            if (res == VK_ERROR_OUT_OF_DATE_KHR) {
-                swapchain->out_of_date = true;
-                VKWSI_LOG(ctx, vkwsi_log_level_warn, "Failed to acquire image due to OUT-OF-DATE condition, retrying...");
-                continue;
-            }
+    VkCommandBuffer cmd = {};
+    res = vkwsi_begin_image_commands(swapchain, &cmd);
+    VKWSI_CHECK(res);
+
+    ctx->CmdPipelineBarrier2(cmd, vkwsi_temp(VkDependencyInfo {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = vkwsi_temp(VkImageMemoryBarrier2 {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .srcAccessMask = src_access,
+            .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .dstAccessMask = dst_access,
+            .oldLayout = old_layout,
+            .newLayout = new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, swapchain->info.image_array_layers },
+        }),
+    }));
+
+    res = ctx->EndCommandBuffer(cmd);
+    VKWSI_CHECK(res);
+
+    *p_cmd = cmd;
+
+    return VK_SUCCESS;
+}
+
+constexpr bool operator==(const vkwsi_present_source& l, const vkwsi_present_source& r)
+{
+    return l.image == r.image
+        && l.layout == r.layout
+        && l.extent == r.extent
+        && l.format == r.format
+        && l.filter == r.filter;
+}
+
+// Records a blit of `source` into the acquired image, leaving it in PRESENT_SRC_KHR. Reuses the image's previous
+// recording if the source hasn't changed.
+static
+VkResult vkwsi_record_blit(vkwsi_swapchain* swapchain, const vkwsi_present_source& source)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    auto& image_res = swapchain->resources[swapchain->image_index];
+    bool shared = vkwsi_is_shared_present_mode(swapchain->info.present_mode);
+
+    // NOTE: Shared images are presented again without waiting for their previous present, so the last blit may still
+    //       be pending. It must complete before it can be submitted again or re-recorded.
+    if (shared && image_res.blit_cmd && image_res.blit_serial > swapchain->retired_serial) {
+        if (ctx->async_present) vkwsi_wait_queued_presents(swapchain, 0);
+
+        res = vkwsi_collect_shared_presents(swapchain, true);
+        VKWSI_CHECK(res);
+        res = vkwsi_wait_for_present_complete(swapchain, swapchain->image_index);
+        VKWSI_CHECK(res);
+    }
+
+    if (image_res.blit_cmd && image_res.blit_source == source) return VK_SUCCESS;
+
+    VkFormatProperties src_props, dst_props;
+    ctx->GetPhysicalDeviceFormatProperties(ctx->physical_device, source.format, &src_props);
+    ctx->GetPhysicalDeviceFormatProperties(ctx->physical_device, swapchain->info.format, &dst_props);
+
+    if (!(src_props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT)) {
+        VKWSI_LOG(ctx, vkwsi_log_level_error, "Source format {} does not support blitting from", int(source.format));
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+    if (!(dst_props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+        VKWSI_LOG(ctx, vkwsi_log_level_error, "Swapchain format {} does not support blitting to", int(swapchain->info.format));
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    auto extent = swapchain->last_extent;
+    auto filter = source.extent == extent ? VK_FILTER_NEAREST : source.filter;
+    if (filter == VK_FILTER_LINEAR && !(src_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+        VKWSI_LOG(ctx, vkwsi_log_level_warn, "Source format {} does not support linear filtering, blitting with nearest", int(source.format));
+        filter = VK_FILTER_NEAREST;
+    }
+
+    // NOTE: Safe to re-record, the image's previous present (and so its last blit submission) has completed. Either
+    //       acquire waited for it, or it was waited for above.
+    res = vkwsi_begin_image_commands(swapchain, &image_res.blit_cmd);
+    VKWSI_CHECK(res);
+
+    // NOTE: Shared presentable images must stay in SHARED_PRESENT_KHR, which supports every usage of the image
+    auto initial_layout = shared ? VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
+    auto blit_layout    = shared ? VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    auto final_layout   = shared ? VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    auto cmd = image_res.blit_cmd;
+    auto range = VkImageSubresourceRange { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    auto layers = VkImageSubresourceLayers { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+
+    ctx->CmdPipelineBarrier2(cmd, vkwsi_temp(VkDependencyInfo {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = vkwsi_temp(VkImageMemoryBarrier2 {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .oldLayout = initial_layout,
+            .newLayout = blit_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image_res.image,
+            .subresourceRange = range,
+        }),
+    }));
+
+    ctx->CmdBlitImage2(cmd, vkwsi_temp(VkBlitImageInfo2 {
+        .sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
+        .srcImage = source.image,
+        .srcImageLayout = source.layout,
+        .dstImage = image_res.image,
+        .dstImageLayout = blit_layout,
+        .regionCount = 1,
+        .pRegions = vkwsi_temp(VkImageBlit2 {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
+            .srcSubresource = layers,
+            .srcOffsets = { {}, { int32_t(source.extent.width), int32_t(source.extent.height), 1 } },
+            .dstSubresource = layers,
+            .dstOffsets = { {}, { int32_t(extent.width), int32_t(extent.height), 1 } },
+        }),
+        .filter = filter,
+    }));
+
+    ctx->CmdPipelineBarrier2(cmd, vkwsi_temp(VkDependencyInfo {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = vkwsi_temp(VkImageMemoryBarrier2 {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .oldLayout = blit_layout,
+            .newLayout = final_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image_res.image,
+            .subresourceRange = range,
+        }),
+    }));
+
+    res = ctx->EndCommandBuffer(cmd);
+    VKWSI_CHECK(res);
+
+    image_res.blit_source = source;
+
+    return VK_SUCCESS;
+}
+
+// Whether the swapchain must be recreated (or checked against the surface capabilities) before acquiring
+static
+bool vkwsi_wants_recreate(vkwsi_swapchain* swapchain)
+{
+    // NOTE: Swapchains scaled from their source extent don't follow the window extent
+    return swapchain->out_of_date
+        || (swapchain->pending_extent != swapchain->last_extent && !swapchain->source_scaled);
+}
+
+// Replaces stale user data of the newly acquired image and creates it if missing. Must only be called once the
+// image's previous present has completed.
+static
+VkResult vkwsi_update_user_data(vkwsi_swapchain* swapchain, uint32_t image_idx)
+{
+    VkResult res;
+
+    auto& image_res = swapchain->resources[image_idx];
+    if (image_res.user_data_stale) vkwsi_destroy_user_data(swapchain, image_res);
+
+    auto& callbacks = swapchain->image_data_callbacks;
+    if (!image_res.user_data && callbacks.create) {
+        // NOTE: Created lazily like image views, so images that are never acquired never get user data
+        auto image = vkwsi_swapchain_get_current(swapchain);
+        res = callbacks.create(callbacks.data, swapchain, &image, &image_res.user_data);
+        VKWSI_CHECK(res);
+        image_res.user_data_callbacks = callbacks;
+    }
+
+    return VK_SUCCESS;
+}
+
+// Acquires an image from a single swapchain, recreating it first if required. Returns VK_NOT_READY if the swapchain
+// should be parked. Only touches `swapchain`, so may run concurrently for different swapchains.
+static
+VkResult vkwsi_acquire_swapchain(vkwsi_swapchain* swapchain, VkSemaphore wait_semaphore, VkFence debug_fence)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    uint32_t image_idx;
+
+    res = vkwsi_collect_retired_swapchains(swapchain, false);
+    VKWSI_CHECK(res);
 
+    // NOTE: OUT-OF-DATE errors can be returned an arbitrary number of times up until the user stops a resize
+    //       operation. Retry a bounded number of times, then park the swapchain. Never sleep here, the caller
+    //       decides how to back off from parked swapchains.
+
+    std::chrono::steady_clock::time_point acquire_start;
+    for (uint32_t attempt = 0;; ++attempt) {
+        // NOTE: Pick up resizes posted while retrying, the user is likely still resizing the window
+        if (attempt > 0) vkwsi_read_mailbox(swapchain);
+
+        if (swapchain->pending_extent.width == 0 || swapchain->pending_extent.height == 0) {
+            res = VK_NOT_READY;
             break;
         }
 
-        if (res != VK_SUBOPTIMAL_KHR) {
+        if (vkwsi_wants_recreate(swapchain)) {
+            if (swapchain->pending_extent != swapchain->last_extent) {
+                VKWSI_LOG(ctx, vkwsi_log_level_trace, "Desired/Actual mismatch ({}, {}) / ({}, {}), checking surface caps",
+                    swapchain->pending_extent.width, swapchain->pending_extent.height,
+                    swapchain->last_extent.width, swapchain->last_extent.height);
+            }
+            res = vkwsi_swapchain_recreate(swapchain);
+            if (res == VK_NOT_READY) break;
             VKWSI_CHECK(res);
+            if (swapchain->out_of_date) {
+                VKWSI_LOG(ctx, vkwsi_log_level_warn, "Failed to recreate swapchain due to surface capabilities race, retrying...");
+            }
         }
+
+        if (ctx->async_present) {
+            // NOTE: Presents that are still queued count as acquired images. Limit how many can be
+            //       in flight so that acquiring can always make forward progress.
+            vkwsi_wait_queued_presents(swapchain, swapchain->acquire_headroom);
+
+            std::scoped_lock lock { swapchain->vk_mutex };
+            acquire_start = std::chrono::steady_clock::now();
+            res = vkwsi_driver_acquire_next_image(ctx, swapchain->swapchain, UINT64_MAX, wait_semaphore, debug_fence, &image_idx);
+        } else {
+            acquire_start = std::chrono::steady_clock::now();
+            res = vkwsi_driver_acquire_next_image(ctx, swapchain->swapchain, UINT64_MAX, wait_semaphore, debug_fence, &image_idx);
+        }
+        if (ctx->recorder) vkwsi_record_driver_acquire(swapchain, res);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+            swapchain->out_of_date = true;
+            if (attempt + 1 >= VKWSI_OUT_OF_DATE_RETRY_LIMIT) {
+                res = VK_NOT_READY;
+                break;
+            }
+            VKWSI_LOG(ctx, vkwsi_log_level_warn, "Failed to acquire image due to OUT-OF-DATE condition, retrying...");
+            continue;
+        }
+
+        break;
+    }
+
+    if (res == VK_NOT_READY) {
+        vkwsi_park_swapchain(swapchain);
+        return VK_TIMEOUT;
+    }
+
+    if (res != VK_SUBOPTIMAL_KHR) {
+        VKWSI_CHECK(res);
+    }
 #if VKWSI_DEBUG_LINEARIZE
-        res = vkwsi_h_wait_and_reset_fence(ctx, debug_fence);
+    res = vkwsi_h_wait_and_reset_fence(ctx, debug_fence);
+    VKWSI_CHECK(res);
+#endif
+    if (swapchain->parked) {
+        VKWSI_LOG(ctx, vkwsi_log_level_info, "Swapchain unparked");
+        swapchain->parked = false;
+    }
+
+    swapchain->image_index = image_idx;
+    swapchain->acquired = true;
+    swapchain->damage.clear();
+
+    // NOTE: In theory we should not have to wait at this point. As acquiring an
+    //       index should imply that all resources from that present are free.
+    //       However, without this wait. The validation layers occasionally
+    //       complain about vkResetFences being used on a VkFence that is still
+    //       in use. It's possible this is just a VVL false positive, but we work
+    //       around it anyway. Ideally we could just:
+    //
+    //           vkwsi_on_present_complete(swapchain, swapchain->resources[image_idx])
+    //
+    res = vkwsi_wait_for_present_complete(swapchain, image_idx);
+    VKWSI_CHECK(res);
+
+    res = vkwsi_read_past_presentation_timing(swapchain);
+    VKWSI_CHECK(res);
+
+    vkwsi_update_adaptive_image_count(swapchain, std::chrono::steady_clock::now() - acquire_start);
+
+    if (!swapchain->resources[image_idx].view) {
+        // NOTE: We create image views lazily, this lets us use deferred swapchain allocation
+        //       without any further changes.
+        res = ctx->CreateImageView(ctx->device, vkwsi_temp(VkImageViewCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = swapchain->resources[image_idx].image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = swapchain->info.format,
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+        }), ctx->alloc, &swapchain->resources[image_idx].view);
+        VKWSI_CHECK(res);
+    }
+
+    // NOTE: Transition command buffers are recorded once per image and reused until the swapchain is recreated.
+    //       They can't be pending twice, as an image is only re-acquired after its previous present has completed.
+    auto& image_res = swapchain->resources[image_idx];
+    bool shared = vkwsi_is_shared_present_mode(swapchain->info.present_mode);
+    if (shared) {
+        // NOTE: This is the only acquire until the swapchain is recreated (see `vkwsi_reacquire_shared`). The image is
+        //       moved to the only layout it may be presented in, and stays there.
+        swapchain->shared_acquired = true;
+        if (!image_res.acquire_cmd) {
+            res = vkwsi_record_transition(swapchain, image_res.image,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR,
+                VK_ACCESS_2_NONE, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+                &image_res.acquire_cmd);
+            VKWSI_CHECK(res);
+        }
+    } else if (swapchain->info.acquire_layout != VK_IMAGE_LAYOUT_UNDEFINED && !image_res.acquire_cmd) {
+        res = vkwsi_record_transition(swapchain, image_res.image,
+            VK_IMAGE_LAYOUT_UNDEFINED, swapchain->info.acquire_layout,
+            VK_ACCESS_2_NONE, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            &image_res.acquire_cmd);
+        VKWSI_CHECK(res);
+    }
+    if (swapchain->info.present_layout != VK_IMAGE_LAYOUT_UNDEFINED && !image_res.present_cmd && !shared) {
+        res = vkwsi_record_transition(swapchain, image_res.image,
+            swapchain->info.present_layout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            VK_ACCESS_2_MEMORY_WRITE_BIT, VK_ACCESS_2_NONE,
+            &image_res.present_cmd);
+        VKWSI_CHECK(res);
+    }
+
+    return vkwsi_update_user_data(swapchain, image_idx);
+}
+
+// Re-acquires the image of a swapchain with a shared present mode, which is still acquired from its first acquire, and
+// polls the swapchain for OUT-OF-DATE. Doesn't wait for the previous present, unless the image's stale user data must
+// be replaced first.
+static
+VkResult vkwsi_reacquire_shared(vkwsi_swapchain* swapchain)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    if (swapchain->resources[swapchain->image_index].user_data_stale) {
+        if (ctx->async_present) vkwsi_wait_queued_presents(swapchain, 0);
+
+        res = vkwsi_collect_shared_presents(swapchain, true);
+        VKWSI_CHECK(res);
+        res = vkwsi_wait_for_present_complete(swapchain, swapchain->image_index);
+        VKWSI_CHECK(res);
+    } else {
+        // NOTE: Only recycles whatever has already completed, the previous present is superseded by the next one
+        res = vkwsi_collect_shared_presents(swapchain, false);
+        VKWSI_CHECK(res);
+        bool complete;
+        res = vkwsi_poll_present_complete(swapchain, swapchain->image_index, &complete);
+        VKWSI_CHECK(res);
+    }
+
+    res = ctx->GetSwapchainStatusKHR(ctx->device, swapchain->swapchain);
+    if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+        VKWSI_LOG(ctx, vkwsi_log_level_warn, "Shared swapchain status is OUT-OF-DATE, recreating...");
+        swapchain->out_of_date = true;
+        return VK_SUCCESS;
+    }
+    if (res != VK_SUBOPTIMAL_KHR) {
         VKWSI_CHECK(res);
+    }
+
+    swapchain->acquired = true;
+    swapchain->damage.clear();
+
+    return vkwsi_update_user_data(swapchain, swapchain->image_index);
+}
+
+struct vkwsi_acquire_job
+{
+    vkwsi_swapchain* swapchain;
+    VkSemaphore wait_semaphore;
+    VkFence debug_fence;
+    VkResult result;
+};
+
+static
+void vkwsi_acquire_job_main(void* job_data, uint32_t index)
+{
+    auto& job = static_cast<vkwsi_acquire_job*>(job_data)[index];
+    job.result = vkwsi_acquire_swapchain(job.swapchain, job.wait_semaphore, job.debug_fence);
+}
+
+static
+VkResult vkwsi_acquire(
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkQueue adapter_queue,
+    const VkSemaphoreSubmitInfo* _signals, uint32_t _signal_count)
+{
+    // NOTE: Acquire semaphores are recycled through a timeline per `adapter_queue`. Signal operation ordering is
+    //       only guaranteed within a queue, so this stays correct with acquires on different queues from
+    //       different threads, which may complete out of order relative to each other.
+
+    if (swapchain_count == 0) return VK_SUCCESS;
+
+    auto ctx = swapchains[0]->ctx;
+    VkResult res;
+
+#if VKWSI_DEBUG_LINEARIZE
+        VkFence debug_fence = ctx->debug_fence;
+#else
+        VkFence debug_fence = nullptr;
 #endif
-        swapchain->image_index = image_idx;
-
-        // NOTE: In theory we should not have to wait at this point. As acquiring an
-        //       index should imply that all resources from that present are free.
-        //       However, without this wait. The validation layers occasionally
-        //       complain about vkResetFences being used on a VkFence that is still
-        //       in use. It's possible this is just a VVL false positive, but we work
-        //       around it anyway. Ideally we could just:
-        //
-        //           vkwsi_on_swapchain_present_complete(swapchain, image_idx)
-        //
-        res = vkwsi_wait_for_present_complete(swapchain, image_idx);
-        VKWSI_CHECK(res);
-
-        if (!swapchain->resources[image_idx].view) {
-            // NOTE: We create image views lazily, this lets us use deferred swapchain allocation
-            //       without any further changes.
-            res = ctx->CreateImageView(ctx->device, vkwsi_temp(VkImageViewCreateInfo {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                .image = swapchain->resources[image_idx].image,
-                .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                .format = swapchain->info.format,
-                .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
-            }), ctx->alloc, &swapchain->resources[image_idx].view);
+
+    // NOTE: We recovery acquire binary semaphores by polling the main context timeline semaphore
+    //       We could also avoid the additional poll by recovering binary semaphores via the appropriate
+    //       `vkwsi_on_present_complete`, however this would force worst-case semaphore reuse.
+    vkwsi_queue_state* queue_state;
+    res = vkwsi_get_queue_state(ctx, adapter_queue, &queue_state);
+    VKWSI_CHECK(res);
+
+    vkwsi_recover_binary_semaphores(ctx, queue_state);
+
+    // Queue state is only touched from this thread, everything per swapchain is gathered into jobs that can run anywhere
+
+    vkwsi_vector<vkwsi_acquire_job> jobs { ctx->alloc };
+    jobs.reserve(swapchain_count);
+    bool any_parked = false;
+    bool any_unchanged = false;
+    for (uint32_t i = 0; i < swapchain_count; ++i) {
+        auto swapchain = swapchains[i];
+
+        vkwsi_read_mailbox(swapchain);
+
+        if (swapchain->parked && std::chrono::steady_clock::now() < swapchain->park_retry_time) {
+            any_parked = true;
+            continue;
+        }
+
+        if (std::exchange(swapchain->unchanged, false)) {
+            // NOTE: Recreated images have no content, so must be acquired and rendered regardless
+            auto keep_alive = swapchain->keep_alive;
+            bool expired = keep_alive.count() && std::chrono::steady_clock::now() - swapchain->last_present_time >= keep_alive;
+            if (swapchain->swapchain && !vkwsi_wants_recreate(swapchain) && !expired) {
+                any_unchanged = true;
+                continue;
+            }
+        }
+
+        if (swapchain->shared_acquired) {
+            if (!vkwsi_wants_recreate(swapchain)) {
+                res = vkwsi_reacquire_shared(swapchain);
+                VKWSI_CHECK(res);
+                if (swapchain->acquired) continue;
+            }
+
+            // NOTE: The image is still acquired, so the swapchain can't be kept even if its extent turns out unchanged
+            swapchain->out_of_date = true;
+        }
+
+        VkSemaphore wait_semaphore = nullptr;
+        res = vkwsi_get_binary_semaphore(ctx, queue_state, &wait_semaphore);
+        VKWSI_CHECK(res);
+        // NOTE: Debug names are only applied when VK_EXT_debug_utils is enabled
+        if (ctx->SetDebugUtilsObjectNameEXT) {
+            res = ctx->SetDebugUtilsObjectNameEXT(ctx->device, vkwsi_temp(VkDebugUtilsObjectNameInfoEXT {
+                .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
+                .objectType = VK_OBJECT_TYPE_SEMAPHORE,
+                .objectHandle = uint64_t(wait_semaphore),
+                .pObjectName = "acquire-semaphore",
+            }));
             VKWSI_CHECK(res);
         }
+
+        jobs.emplace_back(vkwsi_acquire_job {
+            .swapchain = swapchain,
+            .wait_semaphore = wait_semaphore,
+            .debug_fence = debug_fence,
+        });
+    }
+
+    // NOTE: The simulator isn't thread safe, and linearization shares a single fence between all swapchains
+    bool parallel = jobs.size() > 1 && !ctx->simulator && !VKWSI_DEBUG_LINEARIZE;
+    if (parallel && ctx->acquire_job_callback.fn) {
+        ctx->acquire_job_callback.fn(ctx->acquire_job_callback.data, vkwsi_acquire_job_main, jobs.data(), uint32_t(jobs.size()));
+    } else if (parallel && ctx->acquire_workers) {
+        vkwsi_worker_pool_run(ctx->acquire_workers, vkwsi_acquire_job_main, jobs.data(), uint32_t(jobs.size()));
+    } else {
+        for (uint32_t i = 0; i < jobs.size(); ++i) vkwsi_acquire_job_main(jobs.data(), i);
+    }
+
+    // TODO: How do we recover from errors that occur after we have successfully acquired from *some* swapchains
+    //       We need to ensure all swapchains are still in a recoverable state. (Wait and release swapchain images?)
+
+    vkwsi_vector<VkSemaphoreSubmitInfo> wait_infos { ctx->alloc };
+    wait_infos.reserve(jobs.size());
+    // NOTE: Aligned with `wait_infos`, null where no layout transition is required
+    vkwsi_vector<VkCommandBuffer> transition_cmds { ctx->alloc };
+    transition_cmds.reserve(jobs.size());
+    bool any_transitions = false;
+    for (auto& job : jobs) {
+        if (job.result == VK_TIMEOUT) {
+            // NOTE: The semaphore is never signalled if no image was acquired, so it can be reused immediately
+            vkwsi_return_binary_semaphore(queue_state, job.wait_semaphore);
+            any_parked = true;
+            continue;
+        }
+        res = job.result;
+        VKWSI_CHECK(res);
+
+        auto cmd = job.swapchain->resources[job.swapchain->image_index].acquire_cmd;
+        any_transitions |= bool(cmd);
+        transition_cmds.emplace_back(cmd);
+
+        wait_infos.emplace_back(VkSemaphoreSubmitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = job.wait_semaphore,
+            // NOTE: Transitions must wait for the image, otherwise stageMask is irrelevant to the signal-only submit
+            .stageMask = cmd ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : VkPipelineStageFlags2(0),
+        });
     }
 
-    std::vector<VkSemaphoreSubmitInfo> signals;
+    auto acquired_count = uint32_t(wait_infos.size());
+
+    vkwsi_vector<VkSemaphoreSubmitInfo> signals { ctx->alloc };
     signals.reserve(_signal_count + 1);
     signals.emplace_back(VkSemaphoreSubmitInfo {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-        .semaphore = ctx->timeline,
+        .semaphore = queue_state->timeline,
         // NOTE: `value` is set on each submission
     });
     for (uint32_t i = 0; i < _signal_count; ++i) {
         signals.emplace_back(_signals[i]);
     }
 
-    // TODO: Workaround for deadlocking waiting on many binary semaphores by limiting
-    //       how many we wait on each queue submission. Thanks to signal order guarantees
-    //       this results in identical behaviour, just with a bit more overhead (but acquiring
-    //       and presenting from multiple windows is already *expensive* even without factoring this in)
+    // TODO: Workaround for deadlocking waiting on many binary semaphores by limiting
+    //       how many we wait on each queue submission. Thanks to signal order guarantees
+    //       this results in identical behaviour, just with a bit more overhead (but acquiring
+    //       and presenting from multiple windows is already *expensive* even without factoring this in)
+
+    static_assert(VKWSI_MAX_BINARY_WAITS >= 1);
+    uint32_t max_binary_waits = VKWSI_MAX_BINARY_WAITS;
+    if (acquired_count > 3) max_binary_waits = 1;
+
+    // NOTE: Always submit at least once, so that `signals` are signalled even if every swapchain is parked.
+
+    uint64_t timeline_value = queue_state->timeline_value;
+    uint32_t i = 0;
+    do {
+        auto count = std::min(i + max_binary_waits, acquired_count) - i;
+        bool last = i + count >= acquired_count;
+
+        timeline_value = signals[0].value = ++queue_state->timeline_value;
+
+        // NOTE: At most one transition per acquired image waited on
+        VkCommandBufferSubmitInfo cmd_infos[VKWSI_MAX_BINARY_WAITS];
+        uint32_t cmd_count = 0;
+        if (any_transitions) {
+            for (uint32_t j = i; j < i + count; ++j) {
+                if (!transition_cmds[j]) continue;
+                cmd_infos[cmd_count++] = VkCommandBufferSubmitInfo {
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+                    .commandBuffer = transition_cmds[j],
+                };
+            }
+        }
+
+        res = vkwsi_driver_queue_submit2(ctx, adapter_queue, 1, vkwsi_temp(VkSubmitInfo2 {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+            .waitSemaphoreInfoCount = count,
+            .pWaitSemaphoreInfos = wait_infos.data() + i,
+            .commandBufferInfoCount = cmd_count,
+            .pCommandBufferInfos = cmd_infos,
+            .signalSemaphoreInfoCount = last ? (_signal_count + 1) : 1,
+            .pSignalSemaphoreInfos = signals.data(),
+        }), debug_fence);
+        VKWSI_CHECK(res);
+
+#if VKWSI_DEBUG_LINEARIZE
+        res = vkwsi_h_wait_and_reset_fence(ctx, debug_fence);
+        VKWSI_CHECK(res);
+#endif
+
+        i += count;
+    } while (i < acquired_count);
+
+    // NOTE: Signal operations are ordered within the queue, so the last value covers every acquire submitted above
+    for (auto& job : jobs) {
+        if (job.result == VK_TIMEOUT) continue;
+        job.swapchain->acquire_timeline = queue_state->timeline;
+        job.swapchain->acquire_timeline_value = timeline_value;
+    }
+
+    auto& resources = queue_state->acquire_resource_release_queue.emplace_back(timeline_value, vkwsi_vector<VkSemaphore>(ctx->alloc));
+    resources.semaphores.resize(acquired_count);
+    for (uint32_t i = 0; i < acquired_count; ++i) {
+        resources.semaphores[i] = wait_infos[i].semaphore;
+    }
+
+    if (any_parked) return VK_TIMEOUT;
+    if (any_unchanged) return VK_NOT_READY;
+    return VK_SUCCESS;
+}
+
+VkResult vkwsi_swapchain_acquire(
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkQueue adapter_queue,
+    const VkSemaphoreSubmitInfo* signals, uint32_t signal_count)
+try {
+    if (swapchain_count == 0 || !swapchains[0]->ctx->recorder) {
+        return vkwsi_acquire(swapchains, swapchain_count, adapter_queue, signals, signal_count);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto res = vkwsi_acquire(swapchains, swapchain_count, adapter_queue, signals, signal_count);
+    vkwsi_record_swapchains(swapchains[0]->ctx, vkwsi_record_type_swapchain_acquire, start, swapchains, swapchain_count, res);
+    return res;
+} catch (const std::bad_alloc&) {
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+static
+VkResult vkwsi_host_wait(vkwsi_context* ctx, const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, uint64_t timeout_ns)
+{
+    VkResult res;
+
+    // NOTE: Waits are split into fixed size batches so that no allocations are required.
+    //       Waiting for each batch in turn with `waitAll` is equivalent to waiting for all at once.
+
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (timeout_ns != UINT64_MAX) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeout_ns);
+    }
+
+    VkSemaphore semaphores[VKWSI_HOST_WAIT_BATCH_SIZE];
+    uint64_t values[VKWSI_HOST_WAIT_BATCH_SIZE];
+
+    for (uint32_t i = 0; i < wait_count; i += VKWSI_HOST_WAIT_BATCH_SIZE) {
+        auto count = std::min(i + VKWSI_HOST_WAIT_BATCH_SIZE, wait_count) - i;
+        for (uint32_t j = 0; j < count; ++j) {
+            semaphores[j] = waits[i + j].semaphore;
+            values[j] = waits[i + j].value;
+        }
+
+        uint64_t timeout = UINT64_MAX;
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+            timeout = uint64_t(std::max(remaining.count(), decltype(remaining.count())(0)));
+        }
+
+        res = ctx->WaitSemaphores(ctx->device, vkwsi_temp(VkSemaphoreWaitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = count,
+            .pSemaphores = semaphores,
+            .pValues = values,
+        }), timeout);
+        if (res != VK_SUCCESS) return res;
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult vkwsi_swapchain_wait_for_latency(vkwsi_swapchain* swapchain, uint32_t max_queued_frames)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    for (;;) {
+        // NOTE: In async mode, presents that have not been issued yet are always the newest outstanding presents.
+        //       Their fences must not be waited on until the present thread has submitted them.
+        uint32_t queued = ctx->async_present ? swapchain->queued_presents.load(std::memory_order_acquire) : 0;
+
+        // NOTE: Presents to retired swapchains are older than any present to the current one
+        res = vkwsi_collect_retired_swapchains(swapchain, false);
+        VKWSI_CHECK(res);
+
+        // NOTE: As are superseded presents of a shared image
+        res = vkwsi_collect_shared_presents(swapchain, false);
+        VKWSI_CHECK(res);
+
+        uint32_t retired_outstanding = uint32_t(swapchain->shared_presents.size());
+        for (auto& old : swapchain->retired_swapchains) {
+            for (auto& resources : old.resources) {
+                if (resources.present_signal_fence) retired_outstanding++;
+            }
+        }
+
+        uint32_t outstanding = retired_outstanding;
+        uint32_t oldest = UINT32_MAX;
+        for (uint32_t i = 0; i < swapchain->resources.size(); ++i) {
+            bool complete;
+            res = vkwsi_poll_present_complete(swapchain, i, &complete);
+            VKWSI_CHECK(res);
+            if (complete) continue;
+
+            outstanding++;
+            if (oldest == UINT32_MAX || swapchain->resources[i].present_serial < swapchain->resources[oldest].present_serial) {
+                oldest = i;
+            }
+        }
+
+        if (outstanding <= max_queued_frames) break;
+
+        if (retired_outstanding) {
+            res = vkwsi_collect_retired_swapchains(swapchain, true);
+            VKWSI_CHECK(res);
+            if (!swapchain->shared_presents.empty()) {
+                // NOTE: Only the shared image's latest present may still be queued
+                if (ctx->async_present) vkwsi_wait_queued_presents(swapchain, 1);
+                res = vkwsi_collect_shared_presents(swapchain, true);
+                VKWSI_CHECK(res);
+            }
+            continue;
+        }
+
+        if (outstanding <= queued) {
+            vkwsi_wait_queued_presents(swapchain, queued - 1);
+            continue;
+        }
+
+        res = vkwsi_wait_for_present_complete(swapchain, oldest);
+        VKWSI_CHECK(res);
+    }
+
+    return VK_SUCCESS;
+}
+
+vkwsi_swapchain_image vkwsi_swapchain_get_current(vkwsi_swapchain* swapchain)
+{
+    if (!swapchain->acquired) {
+        return {
+            .extent = swapchain->last_extent,
+            .version = swapchain->version,
+        };
+    }
+
+    return {
+        .index = swapchain->image_index,
+        .image = swapchain->resources[swapchain->image_index].image,
+        .view  = swapchain->resources[swapchain->image_index].view,
+        .extent = swapchain->last_extent,
+        .version = swapchain->version,
+        // NOTE: Only one image is acquired at a time, so this image is always the next to be presented
+        .retire_value = swapchain->present_serial + 1,
+        .previous_retire_value = swapchain->resources[swapchain->image_index].present_serial,
+        .user_data = swapchain->resources[swapchain->image_index].user_data,
+        .previous_present_id = swapchain->resources[swapchain->image_index].present_id,
+        .previous_present_time_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            swapchain->resources[swapchain->image_index].present_time.time_since_epoch()).count()),
+    };
+}
+
+void vkwsi_swapchain_set_damage(vkwsi_swapchain* swapchain, const VkRectLayerKHR* rects, uint32_t rect_count)
+{
+    if (!swapchain->ctx->incremental_present) return;
+
+    if (!swapchain->acquired) {
+        VKWSI_LOG(swapchain->ctx, vkwsi_log_level_warn, "Attempted to set damage on swapchain with no acquired image");
+        return;
+    }
+
+    try {
+        swapchain->damage.assign(rects, rects + rect_count);
+    } catch (const std::bad_alloc&) {
+        // NOTE: No damage means the whole image is presented
+        VKWSI_LOG(swapchain->ctx, vkwsi_log_level_error, "Failed to allocate swapchain damage, presenting full image");
+        swapchain->damage.clear();
+    }
+}
+
+uint64_t vkwsi_swapchain_get_park_retry_time(vkwsi_swapchain* swapchain)
+{
+    if (!swapchain->parked) return 0;
+
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(swapchain->park_retry_time.time_since_epoch()).count());
+}
+
+void vkwsi_swapchain_mark_unchanged(vkwsi_swapchain* swapchain)
+{
+    swapchain->unchanged = true;
+}
+
+void vkwsi_swapchain_set_keep_alive(vkwsi_swapchain* swapchain, uint64_t interval_ns)
+{
+    swapchain->keep_alive = std::chrono::nanoseconds(interval_ns);
+}
+
+VkResult vkwsi_swapchain_predict_next_present(vkwsi_swapchain* swapchain, vkwsi_present_prediction* prediction)
+{
+    auto& timing = swapchain->timing;
+
+    if (!vkwsi_is_timed_present_mode(swapchain->info.present_mode) || !timing.refresh_interval.count()) {
+        return VK_NOT_READY;
+    }
+
+    VkResult res;
+
+    uint32_t outstanding = 0;
+    for (uint32_t i = 0; i < swapchain->resources.size(); ++i) {
+        bool complete;
+        res = vkwsi_poll_present_complete(swapchain, i, &complete);
+        VKWSI_CHECK(res);
+        if (!complete) outstanding++;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto refreshes = now > timing.refresh_phase ? (now - timing.refresh_phase) / timing.refresh_interval + 1 : 0;
+    auto next_refresh = timing.refresh_phase + timing.refresh_interval * refreshes;
+    auto next_present = next_refresh + timing.refresh_interval * outstanding;
+
+    auto to_ns = [](std::chrono::steady_clock::time_point time) {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+    };
+
+    *prediction = {
+        .refresh_interval_ns = uint64_t(timing.refresh_interval.count()),
+        .next_refresh_ns = to_ns(next_refresh),
+        .next_present_ns = to_ns(next_present),
+    };
+
+    return VK_SUCCESS;
+}
+
+#if VKWSI_TESTING
+void vkwsi_swapchain_add_timing_sample(vkwsi_swapchain* swapchain, uint64_t time_ns)
+{
+    vkwsi_add_timing_sample(swapchain, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(time_ns)));
+}
+#endif
+
+void vkwsi_swapchain_set_present_timing(vkwsi_swapchain* swapchain, const vkwsi_present_timing* timing)
+{
+    swapchain->present_timing = timing ? *timing : vkwsi_present_timing {};
+}
+
+void vkwsi_swapchain_set_image_data_callbacks(vkwsi_swapchain* swapchain, const vkwsi_image_data_callbacks* callbacks)
+{
+    // NOTE: User data of images that are idle is destroyed straight away. The rest is destroyed once the image is
+    //       no longer in use: when its present completes, or when the acquired image is released or acquired again.
+    for (auto& res : swapchain->resources) {
+        if (!res.user_data) continue;
+
+        if (!res.present_signal_fence && !vkwsi_is_acquired_image(swapchain, res)) {
+            vkwsi_destroy_user_data(swapchain, res);
+        } else {
+            res.user_data_stale = true;
+        }
+    }
+
+    swapchain->image_data_callbacks = callbacks ? *callbacks : vkwsi_image_data_callbacks {};
+}
+
+uint64_t vkwsi_swapchain_get_retired(vkwsi_swapchain* swapchain)
+{
+    vkwsi_collect_retired_swapchains(swapchain, false);
+    vkwsi_collect_shared_presents(swapchain, false);
+
+    for (uint32_t i = 0; i < swapchain->resources.size(); ++i) {
+        bool complete;
+        vkwsi_poll_present_complete(swapchain, i, &complete);
+    }
+
+    return swapchain->retired_serial;
+}
+
+VkResult vkwsi_swapchain_get_retire_semaphore(vkwsi_swapchain* swapchain, VkSemaphore* p_semaphore)
+{
+    auto ctx = swapchain->ctx;
+    VkResult res;
+
+    if (!swapchain->retire_timeline) {
+        res = ctx->CreateSemaphore(ctx->device, vkwsi_temp(VkSemaphoreCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = vkwsi_temp(VkSemaphoreTypeCreateInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+                .initialValue = swapchain->retired_serial,
+            }),
+        }), ctx->alloc, &swapchain->retire_timeline);
+        VKWSI_CHECK(res);
+    }
+
+    *p_semaphore = swapchain->retire_timeline;
+
+    return VK_SUCCESS;
+}
+
+static
+VkResult vkwsi_release(vkwsi_swapchain* const* swapchains, uint32_t swapchain_count)
+{
+    VkResult res;
+
+    for (uint32_t i = 0; i < swapchain_count; ++i) {
+        auto swapchain = swapchains[i];
+        auto ctx = swapchain->ctx;
 
-    uint32_t max_binary_waits = 2;
-    if (swapchain_count > 3) max_binary_waits = 1;
+        if (!swapchain->acquired) {
+            VKWSI_LOG(ctx, vkwsi_log_level_warn, "Attempted to release swapchain with no acquired image");
+            continue;
+        }
 
-    uint64_t timeline_value = ctx->timeline_value;
-    for (uint32_t i = 0; i < swapchain_count; i += max_binary_waits) {
-        auto count = std::min(i + max_binary_waits, swapchain_count) - i;
-        bool last = i + count >= swapchain_count;
+        // NOTE: The acquire semaphore has already been consumed by the acquire adapter submission, and is
+        //       recovered through the context timeline as normal. Only the image itself needs returning.
 
-        timeline_value = signals[0].value = ++ctx->timeline_value;
+        if (swapchain->shared_acquired) {
+            // NOTE: Shared images stay acquired, the next acquire simply hands it out again
+            swapchain->acquired = false;
+            continue;
+        }
 
-        res = ctx->QueueSubmit2(adapter_queue, 1, vkwsi_temp(VkSubmitInfo2 {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-            .waitSemaphoreInfoCount = count,
-            .pWaitSemaphoreInfos = wait_infos.data() + i,
-            .signalSemaphoreInfoCount = last ? (_signal_count + 1) : 1,
-            .pSignalSemaphoreInfos = signals.data(),
-        }), debug_fence);
+        // NOTE: The acquire submission waits on the image and may transition it, so must complete before the image
+        //       can be released. The application is only responsible for its own work.
+        res = ctx->WaitSemaphores(ctx->device, vkwsi_temp(VkSemaphoreWaitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &swapchain->acquire_timeline,
+            .pValues = &swapchain->acquire_timeline_value,
+        }), UINT64_MAX);
         VKWSI_CHECK(res);
 
-#if VKWSI_DEBUG_LINEARIZE
-        res = vkwsi_h_wait_and_reset_fence(ctx, debug_fence);
+        auto release_info = VkReleaseSwapchainImagesInfoEXT {
+            .sType = VK_STRUCTURE_TYPE_RELEASE_SWAPCHAIN_IMAGES_INFO_EXT,
+            .swapchain = swapchain->swapchain,
+            .imageIndexCount = 1,
+            .pImageIndices = &swapchain->image_index,
+        };
+
+        if (ctx->async_present) {
+            std::scoped_lock lock { swapchain->vk_mutex };
+            res = ctx->ReleaseSwapchainImagesEXT(ctx->device, &release_info);
+        } else {
+            res = ctx->ReleaseSwapchainImagesEXT(ctx->device, &release_info);
+        }
         VKWSI_CHECK(res);
-#endif
-    }
 
-    auto& resources = ctx->acquire_resource_release_queue.emplace_back();
-    resources.timeline_value = timeline_value;
-    resources.semaphores.resize(swapchain_count);
-    for (uint32_t i = 0; i < swapchain_count; ++i) {
-        resources.semaphores[i] = wait_infos[i].semaphore;
+        swapchain->acquired = false;
+
+        auto& image_res = swapchain->resources[swapchain->image_index];
+        if (image_res.user_data_stale) vkwsi_destroy_user_data(swapchain, image_res);
     }
 
     return VK_SUCCESS;
 }
 
-vkwsi_swapchain_image vkwsi_swapchain_get_current(vkwsi_swapchain* swapchain)
-{
-    return {
-        .index = swapchain->image_index,
-        .image = swapchain->resources[swapchain->image_index].image,
-        .view  = swapchain->resources[swapchain->image_index].view,
-        .extent = swapchain->last_extent,
-        .version = swapchain->version,
-    };
+VkResult vkwsi_swapchain_release(vkwsi_swapchain* const* swapchains, uint32_t swapchain_count)
+try {
+    if (swapchain_count == 0 || !swapchains[0]->ctx->recorder) {
+        return vkwsi_release(swapchains, swapchain_count);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto res = vkwsi_release(swapchains, swapchain_count);
+    vkwsi_record_swapchains(swapchains[0]->ctx, vkwsi_record_type_swapchain_release, start, swapchains, swapchain_count, res);
+    return res;
+} catch (const std::bad_alloc&) {
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
 }
 
-VkResult vkwsi_swapchain_present(
+static
+VkResult vkwsi_prepare_present(
+    vkwsi_context* ctx, vkwsi_queue_state* queue_state, vkwsi_present_request& request,
     vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
     VkQueue queue,
     const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait)
 {
-    if (swapchain_count == 0) return VK_SUCCESS;
-
-    auto ctx = swapchains[0]->ctx;
     VkResult res;
 
-    VkSemaphore binary_sema = nullptr;
+    // NOTE: All pool and per-image bookkeeping happens here on the calling thread, so that in async mode
+    //       the present thread only ever touches the request itself.
 
-#if VKWSI_DEBUG_LINEARIZE
-        VkFence debug_fence = ctx->debug_fence;
-#else
-        VkFence debug_fence = nullptr;
-#endif
+    // NOTE: Swapchains without an acquired image (parked or released) are skipped
 
-    if (wait_count > 0) {
-        if (host_wait) {
-            std::vector<VkSemaphore> semaphores;
-            std::vector<uint64_t> values;
-            for (uint32_t i = 0; i < wait_count; ++i) {
-                semaphores[i] = waits[i].semaphore;
-                values[i] = waits[i].value;
-            }
+    request.swapchains.clear();
+    for (uint32_t i = 0; i < swapchain_count; ++i) {
+        if (swapchains[i]->acquired) request.swapchains.emplace_back(swapchains[i]);
+    }
+    swapchain_count = uint32_t(request.swapchains.size());
+
+    request.queue = queue;
+    request.host_wait = host_wait && wait_count > 0 && swapchain_count > 0;
+    request.binary_semaphore = nullptr;
+    request.waits.assign(waits, waits + wait_count);
+    request.user_wait_count = wait_count;
+
+    request.cmds.clear();
+    for (auto* sc : request.swapchains) {
+        auto& image_res = sc->resources[sc->image_index];
+        auto cmd = sc->present_from_source ? image_res.blit_cmd : image_res.present_cmd;
+        // NOTE: Takes the serial assigned to this present below
+        if (sc->present_from_source) image_res.blit_serial = sc->present_serial + 1;
+        if (sc->present_from_source && sc->acquire_timeline) {
+            // NOTE: The blit writes the acquired image, which nothing in `waits` needs to have waited for
+            request.waits.emplace_back(VkSemaphoreSubmitInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                .semaphore = sc->acquire_timeline,
+                .value = sc->acquire_timeline_value,
+                .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            });
+        }
+        sc->present_from_source = false;
+        if (cmd) {
+            request.cmds.emplace_back(VkCommandBufferSubmitInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+                .commandBuffer = cmd,
+            });
+        }
+    }
+
+    if (swapchain_count == 0) return VK_SUCCESS;
+
+    // NOTE: Present layout transitions are submitted alongside the waits, so they always need a present semaphore
+    //       even when the waits themselves are performed on the host.
 
-            res = ctx->WaitSemaphores(ctx->device, vkwsi_temp(VkSemaphoreWaitInfo {
-                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
-                .semaphoreCount = uint32_t(wait_count),
-                .pSemaphores = semaphores.data(),
-                .pValues = values.data(),
-            }), UINT64_MAX);
+    vkwsi_present_semaphore* present_semaphore = nullptr;
+    if ((wait_count > 0 && !host_wait) || !request.cmds.empty()) {
+        if (ctx->async_present) {
+            std::scoped_lock lock { queue_state->async_mutex };
+            res = vkwsi_get_present_semaphore(ctx, queue_state, &present_semaphore);
         } else {
-            res = vkwsi_get_binary_semaphore(ctx, &binary_sema);
-            VKWSI_CHECK(res);
+            res = vkwsi_get_present_semaphore(ctx, queue_state, &present_semaphore);
+        }
+        VKWSI_CHECK(res);
+        request.binary_semaphore = present_semaphore->semaphore;
+        if (ctx->SetDebugUtilsObjectNameEXT) {
             res = ctx->SetDebugUtilsObjectNameEXT(ctx->device, vkwsi_temp(VkDebugUtilsObjectNameInfoEXT {
                 .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
                 .objectType = VK_OBJECT_TYPE_SEMAPHORE,
-                .objectHandle = uint64_t(binary_sema),
+                .objectHandle = uint64_t(request.binary_semaphore),
                 .pObjectName = "present-semaphore",
             }));
             VKWSI_CHECK(res);
-
-            res = ctx->QueueSubmit2(queue, 1, vkwsi_temp(VkSubmitInfo2 {
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-                .waitSemaphoreInfoCount = wait_count,
-                .pWaitSemaphoreInfos = waits,
-                .signalSemaphoreInfoCount = 1,
-                .pSignalSemaphoreInfos = vkwsi_temp(VkSemaphoreSubmitInfo {
-                    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-                    .semaphore = binary_sema,
-                }),
-            }), debug_fence);
-            VKWSI_CHECK(res);
-
-#if VKWSI_DEBUG_LINEARIZE
-            res = vkwsi_h_wait_and_reset_fence(ctx, debug_fence);
-            VKWSI_CHECK(res);
-#endif
         }
     }
 
-    std::vector<VkSwapchainKHR> vk_swapchains(swapchain_count);
-    std::vector<uint32_t>             indices(swapchain_count);
-    std::vector<VkFence>       present_fences(swapchain_count);
-    std::vector<VkResult>             results(swapchain_count);
+    auto now = std::chrono::steady_clock::now();
+    request.vk_swapchains.resize(swapchain_count);
+    request.indices.resize(swapchain_count);
+    request.present_modes.resize(swapchain_count);
+    request.fences.resize(swapchain_count);
+    request.results.resize(swapchain_count);
     for (uint32_t i = 0; i < swapchain_count; ++i) {
-        auto& sc = *swapchains[i];
-        vk_swapchains[i] = sc.swapchain;
-        indices[i] = sc.image_index;
+        auto& sc = *request.swapchains[i];
+        request.vk_swapchains[i] = sc.swapchain;
+        request.indices[i] = sc.image_index;
+        sc.acquired = false;
+        sc.last_present_time = now;
+        request.present_modes[i] = sc.info.present_mode;
+
+        auto& image_res = sc.resources[sc.image_index];
+        if (image_res.present_signal_fence && vkwsi_is_shared_present_mode(sc.info.present_mode)) {
+            // NOTE: Shared images are presented again without waiting for their previous present
+            sc.shared_presents.push_back({
+                .fence = image_res.present_signal_fence,
+                .semaphore = image_res.present_wait_semaphore,
+                .serial = image_res.present_serial,
+            });
+            image_res.present_signal_fence = nullptr;
+            image_res.present_wait_semaphore = nullptr;
+        }
 
         // TODO: This should probably just be an assert. (We should also add more asserts *everywhere*)
-        if (sc.resources[sc.image_index].present_signal_fence) {
+        if (image_res.present_signal_fence) {
             VKWSI_LOG(ctx, vkwsi_log_level_error, "Unexpected unreturned fence at index {}", sc.image_index);
         }
 
         VkFence fence;
-        res = vkwsi_get_fence(ctx, &fence);
-        present_fences[i] = fence;
+        res = vkwsi_get_fence(&sc, &fence);
+        request.fences[i] = fence;
         sc.resources[sc.image_index].present_signal_fence = fence;
+        sc.resources[sc.image_index].present_serial = ++sc.present_serial;
+        VKWSI_CHECK(res);
+    }
+
+    // NOTE: Desired present times are forwarded to the presentation engine if possible, and otherwise the whole present
+    //       is held on the host until the latest time any of its swapchains may be issued.
+
+    request.present_times.clear();
+    request.hold_until = {};
+    for (auto* sc : request.swapchains) {
+        auto& image_res = sc->resources[sc->image_index];
+        image_res.present_id = sc->present_timing.present_id;
+        image_res.present_time = {};
+
+        if (ctx->display_timing) {
+            request.present_times.push_back({
+                .presentID = uint32_t(sc->present_serial),
+                .desiredPresentTime = sc->present_timing.desired_present_ns,
+            });
+        } else if (sc->present_timing.desired_present_ns) {
+            request.hold_until = std::max(request.hold_until, vkwsi_present_hold_time(sc, sc->present_timing.desired_present_ns));
+        }
+
+        sc->present_timing = {};
+    }
+
+    // NOTE: Present serials increase with every present to a swapchain, so double as its present IDs
+
+    request.present_ids.clear();
+    if (ctx->present_wait) {
+        for (auto* sc : request.swapchains) request.present_ids.push_back(sc->present_serial);
+    }
+
+    // NOTE: Damage is only forwarded if at least one swapchain has any, swapchains without damage get an empty region
+    //       which updates the whole image.
+
+    request.regions.clear();
+    request.rects.clear();
+    if (std::ranges::any_of(request.swapchains, [](auto* sc) { return !sc->damage.empty(); })) {
+        request.regions.resize(swapchain_count);
+        for (uint32_t i = 0; i < swapchain_count; ++i) {
+            auto& damage = request.swapchains[i]->damage;
+            request.regions[i].rectangleCount = uint32_t(damage.size());
+            request.rects.insert(request.rects.end(), damage.begin(), damage.end());
+            damage.clear();
+        }
+        auto* rects = request.rects.data();
+        for (auto& region : request.regions) {
+            region.pRectangles = rects;
+            rects += region.rectangleCount;
+        }
+    }
+
+    if (present_semaphore) {
+        // TODO: Presents that fail with VK_ERROR_OUT_OF_DATE_KHR still enqueue their wait operations, thus we need
+        //       to consider them before safely releasing the fences and semaphores.
+        present_semaphore->pending.store(swapchain_count, std::memory_order_relaxed);
+        for (auto* swapchain : request.swapchains) {
+            swapchain->resources[swapchain->image_index].present_wait_semaphore = present_semaphore;
+        }
+    }
+
+    return VK_SUCCESS;
+}
+
+static
+VkResult vkwsi_issue_present(vkwsi_context* ctx, vkwsi_present_request& request)
+{
+    VkResult res;
+
+#if VKWSI_DEBUG_LINEARIZE
+        VkFence debug_fence = ctx->debug_fence;
+#else
+        VkFence debug_fence = nullptr;
+#endif
+
+    if (request.binary_semaphore) {
+        // NOTE: Host waits have already been performed, only the waits for the blits remain
+        uint32_t skipped_waits = request.host_wait ? request.user_wait_count : 0u;
+        res = vkwsi_driver_queue_submit2(ctx, request.queue, 1, vkwsi_temp(VkSubmitInfo2 {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+            .waitSemaphoreInfoCount = uint32_t(request.waits.size()) - skipped_waits,
+            .pWaitSemaphoreInfos = request.waits.data() + skipped_waits,
+            .commandBufferInfoCount = uint32_t(request.cmds.size()),
+            .pCommandBufferInfos = request.cmds.data(),
+            .signalSemaphoreInfoCount = 1,
+            .pSignalSemaphoreInfos = vkwsi_temp(VkSemaphoreSubmitInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                .semaphore = request.binary_semaphore,
+            }),
+        }), debug_fence);
         VKWSI_CHECK(res);
+
+#if VKWSI_DEBUG_LINEARIZE
+        res = vkwsi_h_wait_and_reset_fence(ctx, debug_fence);
+        VKWSI_CHECK(res);
+#endif
+    }
+
+    auto swapchain_count = uint32_t(request.swapchains.size());
+
+    // NOTE: Held before locking the swapchains, so that acquires from other threads aren't blocked for the duration
+    if (request.hold_until != std::chrono::steady_clock::time_point {}) {
+        std::this_thread::sleep_until(request.hold_until);
     }
 
+    // NOTE: In async mode the swapchains may be concurrently acquired from on other threads
+    if (ctx->async_present) {
+        for (auto* sc : request.swapchains) sc->vk_mutex.lock();
+    }
+
+    VkSwapchainPresentModeInfoEXT present_mode_info {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODE_INFO_EXT,
+        .swapchainCount = swapchain_count,
+        .pPresentModes = request.present_modes.data(),
+    };
+
+    const void* present_next = &present_mode_info;
+
+    VkPresentRegionsKHR present_regions {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,
+        .pNext = present_next,
+        .swapchainCount = swapchain_count,
+        .pRegions = request.regions.data(),
+    };
+    if (!request.regions.empty()) present_next = &present_regions;
+
+    VkPresentIdKHR present_id {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext = present_next,
+        .swapchainCount = swapchain_count,
+        .pPresentIds = request.present_ids.data(),
+    };
+    if (!request.present_ids.empty()) present_next = &present_id;
+
+    VkPresentTimesInfoGOOGLE present_times {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+        .pNext = present_next,
+        .swapchainCount = swapchain_count,
+        .pTimes = request.present_times.data(),
+    };
+    if (!request.present_times.empty()) present_next = &present_times;
+
     // NOTE: this is not VKWSI_CHECK'd directly. We check each VkResult in `pResults`
-    ctx->QueuePresentKHR(queue, vkwsi_temp(VkPresentInfoKHR {
+    vkwsi_driver_queue_present(ctx, request.queue, vkwsi_temp(VkPresentInfoKHR {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .pNext = vkwsi_temp(VkSwapchainPresentFenceInfoKHR {
             .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_KHR,
+            .pNext = present_next,
             .swapchainCount = swapchain_count,
-            .pFences = present_fences.data(),
+            .pFences = request.fences.data(),
         }),
-        .waitSemaphoreCount = binary_sema ? 1u : 0u,
-        .pWaitSemaphores = &binary_sema,
+        .waitSemaphoreCount = request.binary_semaphore ? 1u : 0u,
+        .pWaitSemaphores = &request.binary_semaphore,
         .swapchainCount = swapchain_count,
-        .pSwapchains = vk_swapchains.data(),
-        .pImageIndices = indices.data(),
-        .pResults = results.data(),
+        .pSwapchains = request.vk_swapchains.data(),
+        .pImageIndices = request.indices.data(),
+        .pResults = request.results.data(),
     }));
 
+    if (ctx->async_present) {
+        for (auto* sc : request.swapchains) sc->vk_mutex.unlock();
+    }
+
+    if (ctx->recorder) vkwsi_record_driver_present(ctx, request);
+
     for (uint32_t i = 0; i < swapchain_count; ++i) {
-        auto& sc = *swapchains[i];
-        if (results[i] == VK_ERROR_OUT_OF_DATE_KHR) {
+        auto& sc = *request.swapchains[i];
+        if (request.results[i] == VK_ERROR_OUT_OF_DATE_KHR) {
             VKWSI_LOG(ctx, vkwsi_log_level_warn, "Present returned OUT-OF-DATE, marking swapchain...");
             sc.out_of_date = true;
             continue;
         }
-        if (results[i] != VK_SUBOPTIMAL_KHR) {
+        if (request.results[i] != VK_SUBOPTIMAL_KHR) {
             // TODO: Same as acquire, we need to handle a critical error here while leaving everything
             //       in an otherwise recoverable state.
-            //       E.g. Note errors, continue on to setup binary semaphore recovery. Then return error code.
-            VKWSI_CHECK(results[i]);
+            res = request.results[i];
+            VKWSI_CHECK(res);
         }
     }
 
-    if (binary_sema) {
-        // TODO: Presents that fail with VK_ERROR_OUT_OF_DATE_KHR still enqueue their wait operations, thus we need
-        //       to consider them before safely releasing the fences and semaphores.
-        ctx->present_semaphore_release_map[binary_sema] = swapchain_count;
-        for (uint32_t i = 0; i < swapchain_count; ++i) {
-            auto* swapchain = swapchains[i];
-            swapchain->resources[swapchain->image_index].last_present_wait_semaphore = binary_sema;
+    return VK_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+
+static
+void vkwsi_present_thread_main(vkwsi_context* ctx)
+{
+    VkResult res;
+
+    for (;;) {
+        auto& request = ctx->present_queue.front();
+        if (request.stop) {
+            ctx->present_queue.pop();
+            break;
+        }
+
+        if (request.swapchains.empty()) {
+            ctx->present_queue.pop();
+            continue;
+        }
+
+        res = VK_SUCCESS;
+        if (request.host_wait) {
+            // NOTE: The host wait timeout only applies to synchronous presents, there is no way
+            //       to report a timeout back to the caller once a present has been enqueued.
+            res = vkwsi_host_wait(ctx, request.waits.data(), request.user_wait_count, UINT64_MAX);
+        }
+
+        if (res == VK_SUCCESS) {
+            res = vkwsi_issue_present(ctx, request);
+        }
+
+        if (res != VK_SUCCESS) {
+            VKWSI_LOG(ctx, vkwsi_log_level_error, "Async present failed: {}", int(res));
+            VkResult expected = VK_SUCCESS;
+            ctx->async_present_result.compare_exchange_strong(expected, res);
+        }
+
+        for (auto* sc : request.swapchains) {
+            sc->queued_presents.fetch_sub(1, std::memory_order_release);
+            sc->queued_presents.notify_all();
+        }
+
+        ctx->present_queue.pop();
+    }
+}
+
+static
+void vkwsi_wait_queued_presents(vkwsi_swapchain* swapchain, uint32_t max_queued)
+{
+    for (;;) {
+        auto queued = swapchain->queued_presents.load(std::memory_order_acquire);
+        if (queued <= max_queued) break;
+        swapchain->queued_presents.wait(queued, std::memory_order_acquire);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// Whether the present of `swapchains` only includes shared images, which need no layout transition or blit submitted
+static
+bool vkwsi_is_shared_only_present(vkwsi_swapchain* const* swapchains, uint32_t swapchain_count)
+{
+    std::span presented { swapchains, swapchain_count };
+    return std::ranges::any_of(presented, [](auto* sc) { return sc->acquired; })
+        && std::ranges::all_of(presented, [](auto* sc) {
+            return !sc->acquired || (vkwsi_is_shared_present_mode(sc->info.present_mode) && !sc->present_from_source);
+        });
+}
+
+// Presents `swapchains` together on `queue`. Any host wait requested has already been performed by the caller in
+// synchronous mode
+static
+VkResult vkwsi_present_on_queue(
+    vkwsi_context* ctx,
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkQueue queue,
+    const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait)
+{
+    VkResult res;
+
+    vkwsi_queue_state* queue_state;
+    res = vkwsi_get_queue_state(ctx, queue, &queue_state);
+    VKWSI_CHECK(res);
+
+    // NOTE: Shared images are rendered in place and presented as is, so their waits are performed on the host instead
+    //       of being converted to a binary semaphore by a submission on every present
+    if (wait_count > 0 && !host_wait && vkwsi_is_shared_only_present(swapchains, swapchain_count)) {
+        if (!ctx->async_present) {
+            res = vkwsi_host_wait(ctx, waits, wait_count, ctx->host_wait_timeout);
+            VKWSI_CHECK(res);
+        }
+        host_wait = true;
+    }
+
+    if (ctx->async_present) {
+        auto& slot = ctx->present_queue.begin_push();
+        auto& request = slot.value;
+        request.stop = false;
+        res = vkwsi_prepare_present(ctx, queue_state, request, swapchains, swapchain_count, queue, waits, wait_count, host_wait);
+        if (res != VK_SUCCESS) {
+            // Publish an empty request to release the queue slot
+            request.swapchains.clear();
+            request.binary_semaphore = nullptr;
+            request.host_wait = false;
         }
+        for (auto* sc : request.swapchains) {
+            sc->queued_presents.fetch_add(1, std::memory_order_relaxed);
+        }
+        ctx->present_queue.end_push(slot);
+        VKWSI_CHECK(res);
+
+        return ctx->async_present_result.exchange(VK_SUCCESS);
     }
 
+    auto& request = queue_state->present_request;
+    res = vkwsi_prepare_present(ctx, queue_state, request, swapchains, swapchain_count, queue, waits, wait_count, host_wait);
+    VKWSI_CHECK(res);
+
+    if (request.swapchains.empty()) return VK_SUCCESS;
+
+    res = vkwsi_issue_present(ctx, request);
+    VKWSI_CHECK(res);
+
 #if VKWSI_DEBUG_LINEARIZE
-    for (uint32_t i = 0; i < swapchain_count; ++i) {
-        res = vkwsi_wait_for_present_complete(swapchains[i], swapchains[i]->image_index);
+    for (auto* swapchain : request.swapchains) {
+        res = vkwsi_wait_for_present_complete(swapchain, swapchain->image_index);
         VKWSI_CHECK(res);
     }
 #endif
 
     return VK_SUCCESS;
 }
+
+// Presents every swapchain on `queue`, or each on `queues[i]` if `queues` is set. If `results` is set, it receives the
+// result for each swapchain
+static
+VkResult vkwsi_present(
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkQueue queue, const VkQueue* queues,
+    const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait,
+    VkResult* results = nullptr)
+{
+    if (swapchain_count == 0) return VK_SUCCESS;
+
+    auto ctx = swapchains[0]->ctx;
+    VkResult res;
+
+    if (!ctx->async_present && wait_count > 0 && host_wait) {
+        res = vkwsi_host_wait(ctx, waits, wait_count, ctx->host_wait_timeout);
+        if (res == VK_TIMEOUT) {
+            VKWSI_LOG(ctx, vkwsi_log_level_warn, "Host wait timed out, swapchains were not presented");
+        }
+        if (res != VK_SUCCESS && results) std::fill_n(results, swapchain_count, res);
+        VKWSI_CHECK(res);
+    }
+
+    if (!queues) {
+        res = vkwsi_present_on_queue(ctx, swapchains, swapchain_count, queue, waits, wait_count, host_wait);
+        if (results) std::fill_n(results, swapchain_count, res);
+        return res;
+    }
+
+    // NOTE: Group swapchains by queue, with one present (and one present semaphore) per queue. Each group waits on
+    //       `waits` separately, and its present semaphore is only shared between the swapchains in that group, so
+    //       fences and semaphores are recycled independently per group.
+    //       Groups are found with a single sort by queue. Ties are broken by index, so that swapchains keep their
+    //       relative order within a group.
+
+    vkwsi_vector<uint32_t> order { ctx->alloc };
+    order.resize(swapchain_count);
+    std::iota(order.begin(), order.end(), 0u);
+    std::ranges::sort(order, [&](uint32_t a, uint32_t b) {
+        if (queues[a] != queues[b]) return std::less<VkQueue>{}(queues[a], queues[b]);
+        return a < b;
+    });
+
+    // NOTE: A binary semaphore can only be waited on once, so can't be shared between groups. Semaphore types can't be
+    //       queried, but binary waits ignore their value and a timeline wait on 0 is always satisfied, so waits on 0
+    //       are taken to be binary.
+    if (wait_count > 0 && !host_wait && queues[order.front()] != queues[order.back()]) {
+        for (uint32_t i = 0; i < wait_count; ++i) {
+            if (waits[i].value != 0) continue;
+            VKWSI_LOG(ctx, vkwsi_log_level_error, "Wait {} looks like a binary semaphore (value 0), presents to more than one queue"
+                " require timeline semaphore waits", i);
+            if (results) std::fill_n(results, swapchain_count, VK_ERROR_VALIDATION_FAILED_EXT);
+            return VK_ERROR_VALIDATION_FAILED_EXT;
+        }
+    }
+
+    vkwsi_vector<vkwsi_swapchain*> group { ctx->alloc };
+    group.reserve(swapchain_count);
+
+    // NOTE: Groups are presented independently, so a failure in one doesn't stop the rest from being presented.
+    //       The first failure is returned, `results` tells the caller which swapchains it affected.
+    VkResult first_error = VK_SUCCESS;
+
+    for (uint32_t begin = 0, end; begin < swapchain_count; begin = end) {
+        auto group_queue = queues[order[begin]];
+
+        group.clear();
+        for (end = begin; end < swapchain_count && queues[order[end]] == group_queue; ++end) {
+            group.emplace_back(swapchains[order[end]]);
+        }
+
+        res = vkwsi_present_on_queue(ctx, group.data(), uint32_t(group.size()), group_queue, waits, wait_count, host_wait);
+        if (results) {
+            for (uint32_t i = begin; i < end; ++i) results[order[i]] = res;
+        }
+        if (res != VK_SUCCESS && first_error == VK_SUCCESS) first_error = res;
+    }
+
+    return first_error;
+}
+
+VkResult vkwsi_swapchain_present(
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkQueue queue,
+    const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait)
+try {
+    if (swapchain_count == 0 || !swapchains[0]->ctx->recorder) {
+        return vkwsi_present(swapchains, swapchain_count, queue, nullptr, waits, wait_count, host_wait);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto res = vkwsi_present(swapchains, swapchain_count, queue, nullptr, waits, wait_count, host_wait);
+    vkwsi_record_swapchains(swapchains[0]->ctx, vkwsi_record_type_swapchain_present, start, swapchains, swapchain_count, res, host_wait, wait_count);
+    return res;
+} catch (const std::bad_alloc&) {
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+VkResult vkwsi_swapchain_present_image(
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    VkQueue queue, const vkwsi_present_source* sources,
+    const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait)
+try {
+    if (swapchain_count == 0) return VK_SUCCESS;
+
+    auto ctx = swapchains[0]->ctx;
+    auto start = std::chrono::steady_clock::now();
+    VkResult res;
+
+    // NOTE: Normally consumed by the present, but a present that fails before it gets that far mustn't leave the blit
+    //       to be submitted by the next one
+    defer { for (uint32_t i = 0; i < swapchain_count; ++i) swapchains[i]->present_from_source = false; };
+
+    for (uint32_t i = 0; i < swapchain_count; ++i) {
+        auto* swapchain = swapchains[i];
+
+        if (sources[i].extent != swapchain->source_extent) {
+            swapchain->source_extent = sources[i].extent;
+            // NOTE: Pick up the new source extent at the next acquire, either to start or stop scaling from it
+            if (swapchain->source_scaled || swapchain->source_scaling_supported) swapchain->out_of_date = true;
+        }
+
+        if (!swapchain->acquired) continue;
+
+        res = vkwsi_record_blit(swapchain, sources[i]);
+        VKWSI_CHECK(res);
+        swapchain->present_from_source = true;
+    }
+
+    res = vkwsi_present(swapchains, swapchain_count, queue, nullptr, waits, wait_count, host_wait);
+    if (ctx->recorder) {
+        vkwsi_record_swapchains(ctx, vkwsi_record_type_swapchain_present, start, swapchains, swapchain_count, res, host_wait, wait_count);
+    }
+    return res;
+} catch (const std::bad_alloc&) {
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
+
+VkResult vkwsi_swapchain_present_queues(
+    vkwsi_swapchain* const* swapchains, uint32_t swapchain_count,
+    const VkQueue* queues,
+    const VkSemaphoreSubmitInfo* waits, uint32_t wait_count, bool host_wait,
+    VkResult* results)
+try {
+    if (swapchain_count == 0 || !swapchains[0]->ctx->recorder) {
+        return vkwsi_present(swapchains, swapchain_count, nullptr, queues, waits, wait_count, host_wait, results);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto res = vkwsi_present(swapchains, swapchain_count, nullptr, queues, waits, wait_count, host_wait, results);
+    vkwsi_record_swapchains(swapchains[0]->ctx, vkwsi_record_type_swapchain_present, start, swapchains, swapchain_count, res, host_wait, wait_count);
+    return res;
+} catch (const std::bad_alloc&) {
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+}
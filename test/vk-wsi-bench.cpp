@@ -0,0 +1,285 @@
+#include "vk-wsi-headless-env.hpp"
+
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <latch>
+#include <memory>
+#include <string>
+
+// -----------------------------------------------------------------------------
+
+// NOTE: Measures the CPU cost of vk-wsi calls on headless swapchains, reporting time spent inside the library rather
+//       than frame rates (which are bound by the driver).
+//
+//     vk-wsi-bench [frames]
+
+struct bench_thread
+{
+    VkQueue queue = {};
+    std::mutex* queue_mutex = {};
+
+    VkCommandPool cmd_pool = {};
+    VkCommandBuffer cmd = {};
+    VkSemaphore timeline = {};
+    uint64_t timeline_value = 0;
+
+    std::vector<vkwsi_swapchain*> swapchains;
+
+    std::chrono::nanoseconds acquire_time = {};
+    std::chrono::nanoseconds present_time = {};
+};
+
+static
+void bench_thread_init(headless_env& env, vkwsi_context* context, bench_thread& thread, uint32_t swapchain_count = 1)
+{
+    vk_check(vkCreateCommandPool(env.device, ptr_to(VkCommandPoolCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = env.queue_family,
+    }), nullptr, &thread.cmd_pool));
+
+    vk_check(vkAllocateCommandBuffers(env.device, ptr_to(VkCommandBufferAllocateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = thread.cmd_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    }), &thread.cmd));
+
+    vk_check(vkCreateSemaphore(env.device, ptr_to(VkSemaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = ptr_to(VkSemaphoreTypeCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        }),
+    }), nullptr, &thread.timeline));
+
+    for (uint32_t i = 0; i < swapchain_count; ++i) {
+        auto& swapchain = thread.swapchains.emplace_back();
+        vk_check(vkwsi_swapchain_create_headless(&swapchain, context));
+
+        auto info = vkwsi_swapchain_info_default();
+        info.min_image_count = 3;
+        info.image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        info.format = VK_FORMAT_B8G8R8A8_UNORM;
+        info.color_space = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+        info.queue_families = &env.queue_family;
+        info.queue_family_count = 1;
+        vkwsi_swapchain_set_info(swapchain, &info);
+        vk_check(vkwsi_swapchain_resize(swapchain, { 64, 64 }));
+    }
+}
+
+static
+void bench_thread_destroy(headless_env& env, bench_thread& thread)
+{
+    for (auto swapchain : thread.swapchains) vkwsi_swapchain_destroy(swapchain);
+    vkDestroySemaphore(env.device, thread.timeline, nullptr);
+    vkDestroyCommandPool(env.device, thread.cmd_pool, nullptr);
+}
+
+static
+void bench_thread_frame(headless_env& env, bench_thread& thread)
+{
+    // Single command buffer, wait for the previous frame to complete before re-recording
+
+    vk_check(vkWaitSemaphores(env.device, ptr_to(VkSemaphoreWaitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &thread.timeline,
+        .pValues = &thread.timeline_value,
+    }), UINT64_MAX));
+
+    // NOTE: Threads sharing a queue (if the device has fewer queues than threads) must synchronize their use of it
+    std::unique_lock lock { *thread.queue_mutex };
+
+    VkSemaphoreSubmitInfo image_ready {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = thread.timeline,
+        .value = ++thread.timeline_value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    vk_check(vkwsi_swapchain_acquire(thread.swapchains.data(), uint32_t(thread.swapchains.size()), thread.queue, &image_ready, 1), VK_TIMEOUT);
+    thread.acquire_time += std::chrono::steady_clock::now() - start;
+
+    vk_check(vkBeginCommandBuffer(thread.cmd, ptr_to(VkCommandBufferBeginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    })));
+    for (auto swapchain : thread.swapchains) {
+        auto current = vkwsi_swapchain_get_current(swapchain);
+        if (!current.image) continue;
+
+        vkCmdPipelineBarrier2(thread.cmd, ptr_to(VkDependencyInfo {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = ptr_to(VkImageMemoryBarrier2 {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = current.image,
+                .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+            }),
+        }));
+    }
+    vk_check(vkEndCommandBuffer(thread.cmd));
+
+    VkSemaphoreSubmitInfo render_complete {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = thread.timeline,
+        .value = ++thread.timeline_value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    vk_check(vkQueueSubmit2(thread.queue, 1, ptr_to(VkSubmitInfo2 {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount = 1,
+        .pWaitSemaphoreInfos = &image_ready,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = ptr_to(VkCommandBufferSubmitInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .commandBuffer = thread.cmd,
+        }),
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &render_complete,
+    }), nullptr));
+
+    start = std::chrono::steady_clock::now();
+    vk_check(vkwsi_swapchain_present(thread.swapchains.data(), uint32_t(thread.swapchains.size()), thread.queue, &render_complete, 1, false));
+    thread.present_time += std::chrono::steady_clock::now() - start;
+}
+
+// Renders `frames` frames on each of `thread_count` threads, each with its own swapchain, sharing a single context
+static
+void bench_contention(headless_env& env, uint32_t thread_count, uint32_t frames)
+{
+    vkwsi_context* context;
+    vk_check(vkwsi_context_create(&context, ptr_to(vkwsi_context_info {
+        .instance = env.instance,
+        .device = env.device,
+        .physical_device = env.physical_device,
+        .get_instance_proc_addr = vkGetInstanceProcAddr,
+    })));
+    defer { vkwsi_context_destroy(context); };
+
+    std::vector<std::unique_ptr<std::mutex>> queue_mutexes;
+    for (uint32_t i = 0; i < env.queues.size(); ++i) queue_mutexes.emplace_back(std::make_unique<std::mutex>());
+
+    std::vector<bench_thread> threads(thread_count);
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        threads[i].queue = env.queues[i % env.queues.size()];
+        threads[i].queue_mutex = queue_mutexes[i % env.queues.size()].get();
+        bench_thread_init(env, context, threads[i]);
+    }
+    defer {
+        vk_check(vkDeviceWaitIdle(env.device));
+        for (auto& thread : threads) bench_thread_destroy(env, thread);
+    };
+
+    // Warm up object pools and swapchain creation before timing
+    for (auto& thread : threads) {
+        for (uint32_t i = 0; i < 8; ++i) bench_thread_frame(env, thread);
+        thread.acquire_time = thread.present_time = {};
+    }
+
+    std::latch start_latch { thread_count + 1 };
+    std::vector<std::jthread> workers;
+    for (auto& thread : threads) {
+        workers.emplace_back([&] {
+            start_latch.arrive_and_wait();
+            for (uint32_t i = 0; i < frames; ++i) bench_thread_frame(env, thread);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    start_latch.arrive_and_wait();
+    workers.clear();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::chrono::nanoseconds acquire_time = {}, present_time = {};
+    for (auto& thread : threads) {
+        acquire_time += thread.acquire_time;
+        present_time += thread.present_time;
+    }
+
+    auto total_frames = double(frames) * thread_count;
+    log_info("  {:2} threads / {} queues: {:8.0f} frames/s, acquire {:6.2f} us, present {:6.2f} us per frame",
+        thread_count, std::min(uint32_t(env.queues.size()), thread_count),
+        total_frames / std::chrono::duration<double>(elapsed).count(),
+        acquire_time.count() / 1e3 / total_frames,
+        present_time.count() / 1e3 / total_frames);
+}
+
+// Renders `frames` frames to `swapchain_count` swapchains from a single thread, acquiring with `acquire_thread_count`
+static
+void bench_swapchains(headless_env& env, uint32_t swapchain_count, uint32_t acquire_thread_count, uint32_t frames)
+{
+    vkwsi_context* context;
+    vk_check(vkwsi_context_create(&context, ptr_to(vkwsi_context_info {
+        .instance = env.instance,
+        .device = env.device,
+        .physical_device = env.physical_device,
+        .get_instance_proc_addr = vkGetInstanceProcAddr,
+        .acquire_thread_count = acquire_thread_count,
+    })));
+    defer { vkwsi_context_destroy(context); };
+
+    std::mutex queue_mutex;
+
+    bench_thread thread;
+    thread.queue = env.queues[0];
+    thread.queue_mutex = &queue_mutex;
+    bench_thread_init(env, context, thread, swapchain_count);
+    defer {
+        vk_check(vkDeviceWaitIdle(env.device));
+        bench_thread_destroy(env, thread);
+    };
+
+    for (uint32_t i = 0; i < 8; ++i) bench_thread_frame(env, thread);
+    thread.acquire_time = thread.present_time = {};
+
+    for (uint32_t i = 0; i < frames; ++i) bench_thread_frame(env, thread);
+
+    log_info("  {:3} swapchains / {} acquire threads: acquire {:8.2f} us, present {:8.2f} us per frame ({:5.2f} / {:5.2f} us per swapchain)",
+        swapchain_count, std::max(acquire_thread_count, 1u),
+        thread.acquire_time.count() / 1e3 / frames,
+        thread.present_time.count() / 1e3 / frames,
+        thread.acquire_time.count() / 1e3 / frames / swapchain_count,
+        thread.present_time.count() / 1e3 / frames / swapchain_count);
+}
+
+// -----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    uint32_t frames = argc > 1 ? uint32_t(std::stoul(argv[1])) : 2000;
+
+    headless_env env;
+    if (!headless_env_create(env, 8)) return skip_return_code;
+    defer { headless_env_destroy(env); };
+
+    log_info("Contention ({} frames per thread)", frames);
+    for (uint32_t thread_count : { 1, 2, 4, 8 }) {
+        bench_contention(env, thread_count, frames);
+    }
+
+    log_info("Swapchain count ({} frames)", frames / 16);
+    for (uint32_t swapchain_count : { 1, 16, 64, 256 }) {
+        bench_swapchains(env, swapchain_count, 1, frames / 16);
+    }
+
+    log_info("Parallel acquire ({} frames)", frames / 8);
+    for (uint32_t acquire_thread_count : { 1, 4 }) {
+        bench_swapchains(env, 32, acquire_thread_count, frames / 8);
+    }
+
+    return 0;
+}
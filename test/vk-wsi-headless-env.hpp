@@ -0,0 +1,245 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "vk-wsi-test-common.hpp"
+#include "vk-wsi-testing.h"
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+// -----------------------------------------------------------------------------
+
+// NOTE: Shared setup for programs that drive vk-wsi against `VK_EXT_headless_surface`, so that they can be run
+//       without a display server (e.g. on lavapipe in CI). Links directly against the Vulkan loader.
+
+static constexpr int skip_return_code = 77;
+
+struct headless_env
+{
+    VkInstance instance = {};
+    VkPhysicalDevice physical_device = {};
+    VkDevice device = {};
+    uint32_t queue_family = ~0u;
+    VkQueue queue = {};
+
+    // Separate queue from the same family (if available) for async presentation
+    VkQueue present_queue = {};
+
+    // All queues created from `queue_family`, `queue` is the first
+    std::vector<VkQueue> queues;
+
+    PFN_vkCreateHeadlessSurfaceEXT vkCreateHeadlessSurfaceEXT = {};
+
+    // Enabled device extensions, including any supported optional extensions that vk-wsi makes use of
+    std::vector<const char*> device_extensions;
+
+    VkSemaphore timeline = {};
+    uint64_t timeline_value = 0;
+
+    VkCommandPool cmd_pool = {};
+    VkCommandBuffer cmd = {};
+
+    vkwsi_context* context = {};
+};
+
+inline
+void log_vkwsi_message(void*, vkwsi_log_level level, const char* message)
+{
+    switch (level) {
+        break;case vkwsi_log_level_error: log_error("vkwsi :: {}", message);
+        break;case vkwsi_log_level_warn:  log_warn ("vkwsi :: {}", message);
+        break;case vkwsi_log_level_info:  log_info ("vkwsi :: {}", message);
+        break;case vkwsi_log_level_trace: log_trace("vkwsi :: {}", message);
+    }
+}
+
+// Creates an instance and device with headless surface support, with up to `max_queue_count` queues from a graphics
+// queue family. Returns false if this isn't supported, in which case the program should exit with `skip_return_code`
+inline
+bool headless_env_create(headless_env& env, uint32_t max_queue_count)
+{
+    const char* instance_extensions[] {
+        VK_KHR_SURFACE_EXTENSION_NAME,
+        VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME,
+        VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME,
+        VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME,
+    };
+
+    auto res = vkCreateInstance(ptr_to(VkInstanceCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = ptr_to(VkApplicationInfo {
+            .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+            .apiVersion = VK_API_VERSION_1_3,
+        }),
+        .enabledExtensionCount = uint32_t(std::size(instance_extensions)),
+        .ppEnabledExtensionNames = instance_extensions,
+    }), nullptr, &env.instance);
+    if (res != VK_SUCCESS) {
+        log_warn("Failed to create instance with headless surface support ({}), skipping", int(res));
+        return false;
+    }
+
+    auto instance = env.instance;
+    vk_instance_fn(vkCreateHeadlessSurfaceEXT);
+    env.vkCreateHeadlessSurfaceEXT = vkCreateHeadlessSurfaceEXT;
+
+    // Pick the first device that supports all required device extensions
+
+    const char* device_extensions[] {
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+        VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME,
+    };
+
+    std::vector<VkPhysicalDevice> physical_devices;
+    vk_enumerate(physical_devices, vkEnumeratePhysicalDevices, env.instance);
+    for (auto physical_device : physical_devices) {
+        std::vector<VkExtensionProperties> extensions;
+        vk_enumerate(extensions, vkEnumerateDeviceExtensionProperties, physical_device, nullptr);
+
+        bool supported = true;
+        for (auto* required : device_extensions) {
+            bool found = false;
+            for (auto& ext : extensions) {
+                if (!std::strcmp(ext.extensionName, required)) {
+                    found = true;
+                    break;
+                }
+            }
+            supported &= found;
+        }
+
+        if (supported) {
+            env.physical_device = physical_device;
+            env.device_extensions.assign(std::begin(device_extensions), std::end(device_extensions));
+            for (auto* optional : { VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME, VK_KHR_SHARED_PRESENTABLE_IMAGE_EXTENSION_NAME,
+                    VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME }) {
+                for (auto& ext : extensions) {
+                    if (!std::strcmp(ext.extensionName, optional)) {
+                        env.device_extensions.emplace_back(optional);
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    if (!env.physical_device) {
+        log_warn("No device supports the required extensions, skipping");
+        return false;
+    }
+
+    // Present waits are only used with both extensions and their features
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR };
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR };
+    present_id_features.pNext = &present_wait_features;
+    vkGetPhysicalDeviceFeatures2(env.physical_device, ptr_to(VkPhysicalDeviceFeatures2 {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &present_id_features,
+    }));
+
+    auto is_present_wait_extension = [](const char* ext) {
+        return !std::strcmp(ext, VK_KHR_PRESENT_ID_EXTENSION_NAME) || !std::strcmp(ext, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    };
+    bool present_wait = std::ranges::count_if(env.device_extensions, is_present_wait_extension) == 2
+        && present_id_features.presentId && present_wait_features.presentWait;
+    if (!present_wait) std::erase_if(env.device_extensions, is_present_wait_extension);
+
+    {
+        VkPhysicalDeviceProperties2 props { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        vkGetPhysicalDeviceProperties2(env.physical_device, &props);
+        log_info("Running on: {}", props.properties.deviceName);
+    }
+
+    std::vector<VkQueueFamilyProperties> queue_props;
+    vk_enumerate(queue_props, vkGetPhysicalDeviceQueueFamilyProperties, env.physical_device);
+    for (uint32_t i = 0; i < queue_props.size(); ++i) {
+        if (queue_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            env.queue_family = i;
+            break;
+        }
+    }
+    if (env.queue_family == ~0u) {
+        log_warn("No graphics queue family, skipping");
+        return false;
+    }
+
+    uint32_t queue_count = std::min(queue_props[env.queue_family].queueCount, max_queue_count);
+    std::vector<float> queue_priorities(queue_count, 1.f);
+
+    vk_check(vkCreateDevice(env.physical_device, ptr_to(VkDeviceCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = ptr_to(VkPhysicalDeviceVulkan12Features {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .pNext = ptr_to(VkPhysicalDeviceVulkan13Features {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+                .pNext = ptr_to(VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT {
+                    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT,
+                    .pNext = present_wait ? &present_id_features : nullptr,
+                    .swapchainMaintenance1 = true,
+                }),
+                .synchronization2 = true,
+            }),
+            .timelineSemaphore = true,
+        }),
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = ptr_to(VkDeviceQueueCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = env.queue_family,
+            .queueCount = queue_count,
+            .pQueuePriorities = queue_priorities.data(),
+        }),
+        .enabledExtensionCount = uint32_t(env.device_extensions.size()),
+        .ppEnabledExtensionNames = env.device_extensions.data(),
+    }), nullptr, &env.device));
+
+    env.queues.resize(queue_count);
+    for (uint32_t i = 0; i < queue_count; ++i) {
+        vkGetDeviceQueue(env.device, env.queue_family, i, &env.queues[i]);
+    }
+    env.queue = env.queues[0];
+    if (queue_count > 1) {
+        env.present_queue = env.queues[1];
+    }
+
+    vk_check(vkCreateSemaphore(env.device, ptr_to(VkSemaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = ptr_to(VkSemaphoreTypeCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        }),
+    }), nullptr, &env.timeline));
+
+    vk_check(vkCreateCommandPool(env.device, ptr_to(VkCommandPoolCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = env.queue_family,
+    }), nullptr, &env.cmd_pool));
+
+    vk_check(vkAllocateCommandBuffers(env.device, ptr_to(VkCommandBufferAllocateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = env.cmd_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    }), &env.cmd));
+
+    return true;
+}
+
+inline
+void headless_env_destroy(headless_env& env)
+{
+    if (env.device) {
+        vkDestroyCommandPool(env.device, env.cmd_pool, nullptr);
+        vkDestroySemaphore(env.device, env.timeline, nullptr);
+        vkDestroyDevice(env.device, nullptr);
+    }
+    if (env.instance) {
+        vkDestroyInstance(env.instance, nullptr);
+    }
+    env = {};
+}
@@ -0,0 +1,2069 @@
+#include "vk-wsi-headless-env.hpp"
+
+#include <vector>
+#include <span>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdlib>
+
+using namespace std::literals;
+
+// -----------------------------------------------------------------------------
+
+// NOTE: Drives the vk-wsi acquire/present lifecycle against `VK_EXT_headless_surface`, so that it can
+//       be run without a display server (e.g. on lavapipe in CI).
+
+#ifndef VKWSI_TEST_SCENARIO_DIR
+# define VKWSI_TEST_SCENARIO_DIR "scenarios"
+#endif
+
+#define expect(cond) if (!(cond)) error(std::source_location::current(), "Expectation failed: " #cond)
+
+// -----------------------------------------------------------------------------
+
+struct headless_window
+{
+    VkSurfaceKHR surface = {};
+    vkwsi_swapchain* swapchain = {};
+    vkwsi_swapchain_info info = {};
+};
+
+// -----------------------------------------------------------------------------
+
+// NOTE: Injects OUT_OF_DATE / SUBOPTIMAL results into the functions loaded by vk-wsi, by wrapping the
+//       loader entry points passed through `vkwsi_context_info::get_instance_proc_addr`.
+
+struct fault_injector
+{
+    PFN_vkGetDeviceProcAddr   GetDeviceProcAddr;
+    PFN_vkCreateSwapchainKHR  CreateSwapchainKHR;
+    PFN_vkAcquireNextImageKHR AcquireNextImageKHR;
+    PFN_vkQueuePresentKHR     QueuePresentKHR;
+
+    // Image count requested by the most recently created swapchain
+    uint32_t swapchain_min_image_count = 0;
+
+    // Number of upcoming calls to fail with each result
+    uint32_t acquire_out_of_date = 0;
+    uint32_t acquire_suboptimal = 0;
+    uint32_t present_out_of_date = 0;
+    uint32_t present_suboptimal = 0;
+
+    // Number of upcoming presents on `present_lost_queue` to fail with SURFACE_LOST
+    VkQueue present_lost_queue = {};
+    uint32_t present_surface_lost = 0;
+};
+
+static fault_injector injector;
+
+static
+VKAPI_ATTR VkResult VKAPI_CALL inject_create_swapchain(
+    VkDevice device, const VkSwapchainCreateInfoKHR* info, const VkAllocationCallbacks* alloc, VkSwapchainKHR* swapchain)
+{
+    injector.swapchain_min_image_count = info->minImageCount;
+    return injector.CreateSwapchainKHR(device, info, alloc, swapchain);
+}
+
+static
+VKAPI_ATTR VkResult VKAPI_CALL inject_acquire_next_image(
+    VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore, VkFence fence, uint32_t* index)
+{
+    if (injector.acquire_out_of_date) {
+        // No image is acquired and `semaphore` is left unsignalled, as with a real OUT_OF_DATE error
+        injector.acquire_out_of_date--;
+        return VK_ERROR_OUT_OF_DATE_KHR;
+    }
+
+    auto res = injector.AcquireNextImageKHR(device, swapchain, timeout, semaphore, fence, index);
+    if (res == VK_SUCCESS && injector.acquire_suboptimal) {
+        injector.acquire_suboptimal--;
+        return VK_SUBOPTIMAL_KHR;
+    }
+
+    return res;
+}
+
+static
+VKAPI_ATTR VkResult VKAPI_CALL inject_queue_present(VkQueue queue, const VkPresentInfoKHR* info)
+{
+    auto res = injector.QueuePresentKHR(queue, info);
+
+    auto inject = [&](uint32_t& count, VkResult result) {
+        for (; count && res == VK_SUCCESS; --count) {
+            // Presents still go ahead, so that waits and present fences complete as normal
+            res = result;
+            if (info->pResults) {
+                for (uint32_t i = 0; i < info->swapchainCount; ++i) info->pResults[i] = result;
+            }
+            break;
+        }
+    };
+    inject(injector.present_out_of_date, VK_ERROR_OUT_OF_DATE_KHR);
+    inject(injector.present_suboptimal, VK_SUBOPTIMAL_KHR);
+    if (queue == injector.present_lost_queue) inject(injector.present_surface_lost, VK_ERROR_SURFACE_LOST_KHR);
+
+    return res;
+}
+
+static
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL inject_get_device_proc_addr(VkDevice device, const char* name)
+{
+    if (std::strcmp(name, "vkCreateSwapchainKHR") == 0) {
+        injector.CreateSwapchainKHR = reinterpret_cast<PFN_vkCreateSwapchainKHR>(injector.GetDeviceProcAddr(device, name));
+        return reinterpret_cast<PFN_vkVoidFunction>(inject_create_swapchain);
+    }
+    if (std::strcmp(name, "vkAcquireNextImageKHR") == 0) {
+        injector.AcquireNextImageKHR = reinterpret_cast<PFN_vkAcquireNextImageKHR>(injector.GetDeviceProcAddr(device, name));
+        return reinterpret_cast<PFN_vkVoidFunction>(inject_acquire_next_image);
+    }
+    if (std::strcmp(name, "vkQueuePresentKHR") == 0) {
+        injector.QueuePresentKHR = reinterpret_cast<PFN_vkQueuePresentKHR>(injector.GetDeviceProcAddr(device, name));
+        return reinterpret_cast<PFN_vkVoidFunction>(inject_queue_present);
+    }
+    return injector.GetDeviceProcAddr(device, name);
+}
+
+static
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL inject_get_instance_proc_addr(VkInstance instance, const char* name)
+{
+    if (std::strcmp(name, "vkGetDeviceProcAddr") == 0) {
+        injector.GetDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(vkGetInstanceProcAddr(instance, name));
+        return reinterpret_cast<PFN_vkVoidFunction>(inject_get_device_proc_addr);
+    }
+    return vkGetInstanceProcAddr(instance, name);
+}
+
+// -----------------------------------------------------------------------------
+
+static
+vkwsi_context_info make_context_info(headless_env& env)
+{
+    return {
+        .instance = env.instance,
+        .device = env.device,
+        .physical_device = env.physical_device,
+        .get_instance_proc_addr = inject_get_instance_proc_addr,
+        .enabled_device_extensions = env.device_extensions.data(),
+        .enabled_device_extension_count = uint32_t(env.device_extensions.size()),
+        .log_callback = {
+            .fn = log_vkwsi_message,
+        },
+    };
+}
+
+static
+headless_window create_window(headless_env& env, vkwsi_context* context, VkExtent2D extent,
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR)
+{
+    headless_window window;
+
+    vk_check(env.vkCreateHeadlessSurfaceEXT(env.instance, ptr_to(VkHeadlessSurfaceCreateInfoEXT {
+        .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+    }), nullptr, &window.surface));
+
+    vk_check(vkwsi_swapchain_create(&window.swapchain, context, window.surface));
+
+    VkSurfaceFormatKHR surface_format = {};
+    std::vector<VkSurfaceFormatKHR> surface_formats;
+    vk_enumerate(surface_formats, vkGetPhysicalDeviceSurfaceFormatsKHR, env.physical_device, window.surface);
+    expect(!surface_formats.empty());
+    surface_format = surface_formats[0];
+    for (auto& f : surface_formats) {
+        if (f.format == VK_FORMAT_R8G8B8A8_UNORM || f.format == VK_FORMAT_B8G8R8A8_UNORM) {
+            surface_format = f;
+            break;
+        }
+    }
+
+    vkwsi_swapchain_info info = vkwsi_swapchain_info_default();
+    info.queue_families = &env.queue_family;
+    info.queue_family_count = 1;
+    info.image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    info.present_mode = vkwsi_context_pick_present_mode(context, window.surface, &present_mode, 1);
+    info.min_image_count = 2;
+    info.format = surface_format.format;
+    info.color_space = surface_format.colorSpace;
+    vkwsi_swapchain_set_info(window.swapchain, &info);
+    window.info = info;
+
+    vk_check(vkwsi_swapchain_resize(window.swapchain, extent));
+
+    return window;
+}
+
+static
+void destroy_window(headless_env& env, headless_window& window)
+{
+    vkwsi_swapchain_destroy(window.swapchain);
+    vkDestroySurfaceKHR(env.instance, window.surface, nullptr);
+    window = {};
+}
+
+static
+void wait_timeline(headless_env& env, uint64_t value)
+{
+    vk_check(vkWaitSemaphores(env.device, ptr_to(VkSemaphoreWaitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &env.timeline,
+        .pValues = &value,
+    }), UINT64_MAX));
+}
+
+// Acquires, clears and submits a frame for all `swapchains`. Returns the timeline value signalled on render completion
+// If `layout` is set, acquired images are already in that layout (and stay in it) instead of being transitioned here
+static
+uint64_t render_frame(headless_env& env, std::span<vkwsi_swapchain* const> swapchains, VkResult* p_acquire_result = nullptr,
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED)
+{
+    // Single command buffer, wait for the previous frame to complete before re-recording
+
+    wait_timeline(env, env.timeline_value);
+
+    VkSemaphoreSubmitInfo image_ready {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = env.timeline,
+        .value = ++env.timeline_value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    auto res = vk_check(vkwsi_swapchain_acquire(swapchains.data(), uint32_t(swapchains.size()), env.queue, &image_ready, 1), VK_NOT_READY, VK_TIMEOUT);
+    if (p_acquire_result) *p_acquire_result = res;
+
+    vk_check(vkBeginCommandBuffer(env.cmd, ptr_to(VkCommandBufferBeginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    })));
+
+    for (auto* swapchain : swapchains) {
+        auto current = vkwsi_swapchain_get_current(swapchain);
+        if (!current.image) continue;
+
+        auto transition = [&](VkImageLayout old_layout, VkImageLayout new_layout) {
+            vkCmdPipelineBarrier2(env.cmd, ptr_to(VkDependencyInfo {
+                .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                .imageMemoryBarrierCount = 1,
+                .pImageMemoryBarriers = ptr_to(VkImageMemoryBarrier2 {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                    .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                    .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+                    .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                    .dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT,
+                    .oldLayout = old_layout,
+                    .newLayout = new_layout,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = current.image,
+                    .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+                }),
+            }));
+        };
+
+        bool transitions = layout == VK_IMAGE_LAYOUT_UNDEFINED;
+        if (transitions) transition(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vkCmdClearColorImage(env.cmd, current.image, transitions ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : layout,
+            ptr_to(VkClearColorValue{.float32{0.3f, 0.3f, 0.3f, 1.f}}),
+            1, ptr_to(VkImageSubresourceRange { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }));
+        if (transitions) transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
+
+    vk_check(vkEndCommandBuffer(env.cmd));
+
+    VkSemaphoreSubmitInfo render_complete {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = env.timeline,
+        .value = ++env.timeline_value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    vk_check(vkQueueSubmit2(env.queue, 1, ptr_to(VkSubmitInfo2 {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount = 1,
+        .pWaitSemaphoreInfos = &image_ready,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = ptr_to(VkCommandBufferSubmitInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .commandBuffer = env.cmd,
+        }),
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &render_complete,
+    }), nullptr));
+
+    return render_complete.value;
+}
+
+static
+VkResult present_frame(headless_env& env, std::span<vkwsi_swapchain* const> swapchains, uint64_t value, bool host_wait, VkQueue queue = {})
+{
+    VkSemaphoreSubmitInfo render_complete {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = env.timeline,
+        .value = value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    return vkwsi_swapchain_present(swapchains.data(), uint32_t(swapchains.size()), queue ? queue : env.queue, &render_complete, 1, host_wait);
+}
+
+// -----------------------------------------------------------------------------
+
+static
+void test_present_device_wait(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+    }
+}
+
+static
+void test_present_host_wait(headless_env& env)
+{
+    headless_window windows[] {
+        create_window(env, env.context, { 256, 256 }),
+        create_window(env, env.context, { 128, 64 }),
+    };
+    defer { for (auto& w : windows) destroy_window(env, w); };
+
+    vkwsi_swapchain* swapchains[] { windows[0].swapchain, windows[1].swapchain };
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto value = render_frame(env, swapchains);
+
+        // More waits than fit in a single host wait batch
+
+        VkSemaphoreSubmitInfo waits[40];
+        for (uint32_t j = 0; j < std::size(waits); ++j) {
+            waits[j] = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                .semaphore = env.timeline,
+                .value = value - (j % 2),
+            };
+        }
+
+        vk_check(vkwsi_swapchain_present(swapchains, uint32_t(std::size(swapchains)), env.queue, waits, uint32_t(std::size(waits)), true));
+    }
+}
+
+static
+void test_host_wait_timeout(headless_env& env)
+{
+    auto info = make_context_info(env);
+    info.host_wait_timeout = std::chrono::nanoseconds(50ms).count();
+
+    vkwsi_context* context;
+    vk_check(vkwsi_context_create(&context, &info));
+    defer { vkwsi_context_destroy(context); };
+
+    auto window = create_window(env, context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    auto value = render_frame(env, { &window.swapchain, 1 });
+
+    // Wait on a value that has not been signalled yet
+
+    auto pending_value = value + 1;
+    auto res = present_frame(env, { &window.swapchain, 1 }, pending_value, true);
+    expect(res == VK_TIMEOUT);
+
+    // Signal from the host, presenting again should now succeed
+
+    wait_timeline(env, value);
+    vk_check(vkSignalSemaphore(env.device, ptr_to(VkSemaphoreSignalInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+        .semaphore = env.timeline,
+        .value = pending_value,
+    })));
+    env.timeline_value = pending_value;
+
+    vk_check(present_frame(env, { &window.swapchain, 1 }, pending_value, true));
+}
+
+static
+void test_async_present(headless_env& env)
+{
+    if (!env.present_queue) {
+        log_warn("  No second queue available for async presentation, skipping");
+        return;
+    }
+
+    auto info = make_context_info(env);
+    info.async_present = true;
+
+    vkwsi_context* context;
+    vk_check(vkwsi_context_create(&context, &info));
+    defer { vkwsi_context_destroy(context); };
+
+    headless_window windows[] {
+        create_window(env, context, { 256, 256 }, VK_PRESENT_MODE_MAILBOX_KHR),
+        create_window(env, context, { 64, 64 }, VK_PRESENT_MODE_MAILBOX_KHR),
+    };
+    defer { for (auto& w : windows) destroy_window(env, w); };
+
+    vkwsi_swapchain* swapchains[] { windows[0].swapchain, windows[1].swapchain };
+
+    for (uint32_t i = 0; i < 64; ++i) {
+        // Resize part way through to force recreation with presents in flight
+        if (i == 32) vk_check(vkwsi_swapchain_resize(windows[0].swapchain, { 200, 100 }));
+
+        auto value = render_frame(env, swapchains);
+        vk_check(present_frame(env, swapchains, value, i % 2, env.present_queue));
+    }
+
+    expect(vkwsi_swapchain_get_current(windows[0].swapchain).extent.width == 200);
+}
+
+static
+void test_present_queues(headless_env& env)
+{
+    if (!env.present_queue) {
+        log_warn("  No second queue available, skipping");
+        return;
+    }
+
+    headless_window windows[] {
+        create_window(env, env.context, { 256, 256 }),
+        create_window(env, env.context, { 128, 128 }),
+        create_window(env, env.context, { 64, 64 }),
+    };
+    defer { for (auto& w : windows) destroy_window(env, w); };
+
+    vkwsi_swapchain* swapchains[] { windows[0].swapchain, windows[1].swapchain, windows[2].swapchain };
+    VkQueue queues[] { env.queue, env.present_queue, env.queue };
+
+    // Run for many more frames than there are images, so that fences and semaphores from each group must be recycled
+
+    for (uint32_t i = 0; i < 32; ++i) {
+        auto value = render_frame(env, swapchains);
+
+        VkSemaphoreSubmitInfo render_complete {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = env.timeline,
+            .value = value,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+        VkResult results[3];
+        vk_check(vkwsi_swapchain_present_queues(swapchains, 3, queues, &render_complete, 1, i % 4 == 3, results));
+        for (auto result : results) vk_check(result);
+    }
+
+    // Waits that look like binary semaphores can't be shared between groups, and are rejected before presenting
+
+    {
+        auto value = render_frame(env, swapchains);
+
+        VkSemaphoreSubmitInfo render_complete {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = env.timeline,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+
+        VkResult results[3];
+        expect(vkwsi_swapchain_present_queues(swapchains, 3, queues, &render_complete, 1, false, results) == VK_ERROR_VALIDATION_FAILED_EXT);
+        for (auto result : results) expect(result == VK_ERROR_VALIDATION_FAILED_EXT);
+
+        render_complete.value = value;
+        vk_check(vkwsi_swapchain_present_queues(swapchains, 3, queues, &render_complete, 1, false, results));
+    }
+
+    // A failing group is reported for its own swapchains, and doesn't stop the other group from being presented
+
+    {
+        auto value = render_frame(env, swapchains);
+
+        VkSemaphoreSubmitInfo render_complete {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = env.timeline,
+            .value = value,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+
+        injector.present_lost_queue = env.present_queue;
+        injector.present_surface_lost = 1;
+        defer { injector.present_lost_queue = {}; injector.present_surface_lost = 0; };
+
+        VkResult results[3];
+        auto res = vkwsi_swapchain_present_queues(swapchains, 3, queues, &render_complete, 1, false, results);
+        expect(res == VK_ERROR_SURFACE_LOST_KHR);
+        expect(results[0] == VK_SUCCESS);
+        expect(results[1] == VK_ERROR_SURFACE_LOST_KHR);
+        expect(results[2] == VK_SUCCESS);
+        expect(injector.present_surface_lost == 0);
+    }
+
+    for (auto* swapchain : swapchains) {
+        vk_check(vkwsi_swapchain_wait_for_latency(swapchain, 0));
+    }
+}
+
+static
+void test_parallel_acquire(headless_env& env)
+{
+    auto run = [&](vkwsi_context_info info) {
+        vkwsi_context* context;
+        vk_check(vkwsi_context_create(&context, &info));
+        defer { vkwsi_context_destroy(context); };
+
+        std::vector<headless_window> windows;
+        std::vector<vkwsi_swapchain*> swapchains;
+        for (uint32_t i = 0; i < 8; ++i) {
+            windows.emplace_back(create_window(env, context, { 64 + i * 16, 64 }));
+            swapchains.emplace_back(windows.back().swapchain);
+        }
+        defer { for (auto& w : windows) destroy_window(env, w); };
+
+        for (uint32_t i = 0; i < 32; ++i) {
+            // Resize some windows part way through to recreate in parallel, and park another
+            if (i == 16) {
+                for (uint32_t j = 0; j < 4; ++j) vk_check(vkwsi_swapchain_resize(swapchains[j], { 100, 100 }));
+                vk_check(vkwsi_swapchain_resize(swapchains[7], { 0, 0 }));
+            }
+
+            auto value = render_frame(env, swapchains);
+            vk_check(present_frame(env, swapchains, value, false));
+        }
+
+        for (uint32_t j = 0; j < 4; ++j) expect(vkwsi_swapchain_get_current(swapchains[j]).extent.width == 100);
+        expect(vkwsi_swapchain_get_current(swapchains[4]).image);
+        expect(!vkwsi_swapchain_get_current(swapchains[7]).image);
+    };
+
+    // Library owned workers
+
+    auto info = make_context_info(env);
+    info.acquire_thread_count = 4;
+    run(info);
+
+    // Application job system, here one thread per job
+
+    info = make_context_info(env);
+    info.acquire_job_callback.fn = [](void*, vkwsi_job_fn job, void* job_data, uint32_t count) {
+        std::vector<std::jthread> threads;
+        for (uint32_t i = 0; i < count; ++i) threads.emplace_back(job, job_data, i);
+    };
+    run(info);
+}
+
+static
+void test_latency_limiter(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    // NOTE: FIFO presents retire in order, so the frames still queued are exactly those presented but not yet retired
+
+    uint64_t presented = 0;
+    auto queued = [&] { return presented - vkwsi_swapchain_get_retired(window.swapchain); };
+
+    for (uint32_t i = 0; i < 32; ++i) {
+        uint32_t limit = i % 3;
+        vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, limit));
+        expect(queued() <= limit);
+
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        presented++;
+    }
+
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+    expect(queued() == 0);
+
+    // Hold presents back behind a gate that is only opened from another thread, so that the limit is reached for
+    // certain. The gate opens after a delay, in case the driver waits for present semaphores on the host.
+
+    VkSemaphore gate;
+    vk_check(vkCreateSemaphore(env.device, ptr_to(VkSemaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = ptr_to(VkSemaphoreTypeCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        }),
+    }), nullptr, &gate));
+    defer { vkDestroySemaphore(env.device, gate, nullptr); };
+
+    std::atomic<bool> opened = false;
+    std::jthread opener([&] {
+        std::this_thread::sleep_for(100ms);
+        opened = true;
+        vk_check(vkSignalSemaphore(env.device, ptr_to(VkSemaphoreSignalInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+            .semaphore = gate,
+            .value = 1,
+        })));
+    });
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        VkSemaphoreSubmitInfo waits[] {
+            {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                .semaphore = env.timeline,
+                .value = value,
+                .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                .semaphore = gate,
+                .value = 1,
+                .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            },
+        };
+        vk_check(vkwsi_swapchain_present(&window.swapchain, 1, env.queue, waits, uint32_t(std::size(waits)), false));
+        presented++;
+    }
+
+    // Either the limit was reached with the gate still closed, and the limiter must block until it opens, or the
+    // presents themselves already waited for the gate.
+    bool reached = queued() > 1;
+    expect(reached || opened);
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 1));
+    expect(opened);
+    expect(queued() <= 1);
+
+    opener.join();
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+    expect(queued() == 0);
+}
+
+static
+void test_retire_counter(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    VkSemaphore retire_semaphore;
+    vk_check(vkwsi_swapchain_get_retire_semaphore(window.swapchain, &retire_semaphore));
+
+    uint64_t last_retired = 0;
+    for (uint32_t i = 0; i < 32; ++i) {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+
+        auto current = vkwsi_swapchain_get_current(window.swapchain);
+        expect(current.retire_value == i + 1);
+        expect(current.previous_retire_value < current.retire_value);
+
+        // The image's previous present must have retired by the time it is acquired again
+        auto retired = vkwsi_swapchain_get_retired(window.swapchain);
+        expect(retired >= current.previous_retire_value);
+        expect(retired >= last_retired);
+        last_retired = retired;
+
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+    }
+
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+    expect(vkwsi_swapchain_get_retired(window.swapchain) == 32);
+
+    uint64_t semaphore_value;
+    vk_check(vkGetSemaphoreCounterValue(env.device, retire_semaphore, &semaphore_value));
+    expect(semaphore_value == 32);
+}
+
+static
+void test_image_data(headless_env& env)
+{
+    struct image_data
+    {
+        VkImage image;
+        uint64_t version;
+    };
+
+    struct image_data_counts
+    {
+        uint32_t created = 0;
+        uint32_t destroyed = 0;
+    } counts, new_counts;
+
+    auto window = create_window(env, env.context, { 256, 256 });
+    bool destroyed = false;
+    defer { if (!destroyed) destroy_window(env, window); };
+
+    vkwsi_image_data_callbacks callbacks {
+        .create = [](void* data, vkwsi_swapchain*, const vkwsi_swapchain_image* image, void** user_data) {
+            static_cast<image_data_counts*>(data)->created++;
+            *user_data = new image_data { image->image, image->version };
+            return VK_SUCCESS;
+        },
+        .destroy = [](void* data, vkwsi_swapchain*, void* user_data) {
+            static_cast<image_data_counts*>(data)->destroyed++;
+            delete static_cast<image_data*>(user_data);
+        },
+        .data = &counts,
+    };
+    vkwsi_swapchain_set_image_data_callbacks(window.swapchain, &callbacks);
+
+    auto frame = [&] {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        auto current = vkwsi_swapchain_get_current(window.swapchain);
+        auto data = static_cast<image_data*>(current.user_data);
+        expect(data && data->image == current.image && data->version == current.version);
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+    };
+
+    // Created once per image, no matter how often each image is acquired
+
+    for (uint32_t i = 0; i < 16; ++i) frame();
+    auto image_count = counts.created;
+    expect(image_count > 0 && counts.destroyed == 0);
+
+    // Recreation destroys the previous images' data once their presents complete, and creates it again for the new
+    // images
+
+    vk_check(vkwsi_swapchain_resize(window.swapchain, { 128, 128 }));
+    for (uint32_t i = 0; i < 16; ++i) frame();
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+    expect(counts.destroyed == image_count);
+
+    // Replacing the callbacks keeps the acquired image's data alive until its present has completed
+
+    {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        auto current = vkwsi_swapchain_get_current(window.swapchain);
+
+        auto new_callbacks = callbacks;
+        new_callbacks.data = &new_counts;
+        vkwsi_swapchain_set_image_data_callbacks(window.swapchain, &new_callbacks);
+
+        expect(counts.destroyed < counts.created);
+        auto data = static_cast<image_data*>(vkwsi_swapchain_get_current(window.swapchain).user_data);
+        expect(data == current.user_data && data->image == current.image);
+
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+        expect(counts.destroyed == counts.created);
+
+        frame();
+        expect(new_counts.created == 1);
+    }
+
+    destroy_window(env, window);
+    destroyed = true;
+    expect(counts.destroyed == counts.created);
+    expect(new_counts.destroyed == new_counts.created);
+}
+
+static
+void test_layout_transitions(headless_env& env)
+{
+    headless_window windows[] {
+        create_window(env, env.context, { 256, 256 }),
+        create_window(env, env.context, { 128, 64 }),
+    };
+    defer { for (auto& w : windows) destroy_window(env, w); };
+
+    vkwsi_swapchain* swapchains[] { windows[0].swapchain, windows[1].swapchain };
+
+    for (auto& window : windows) {
+        window.info.acquire_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        window.info.present_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        vkwsi_swapchain_set_info(window.swapchain, &window.info);
+    }
+
+    // Device waits, host waits and recreation all with transitions recorded by the library
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto value = render_frame(env, swapchains, nullptr, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vk_check(present_frame(env, swapchains, value, i % 2 == 1));
+    }
+
+    vk_check(vkwsi_swapchain_resize(windows[0].swapchain, { 64, 64 }));
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto value = render_frame(env, swapchains, nullptr, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vk_check(present_frame(env, swapchains, value, false));
+    }
+}
+
+static
+void test_present_image(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    // Offscreen render target at a fixed internal resolution
+
+    VkExtent2D render_extent { 160, 90 };
+
+    VkImage image;
+    vk_check(vkCreateImage(env.device, ptr_to(VkImageCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = window.info.format,
+        .extent = { render_extent.width, render_extent.height, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    }), nullptr, &image));
+    defer { vkDestroyImage(env.device, image, nullptr); };
+
+    VkMemoryRequirements mem_reqs;
+    vkGetImageMemoryRequirements(env.device, image, &mem_reqs);
+    VkPhysicalDeviceMemoryProperties mem_props;
+    vkGetPhysicalDeviceMemoryProperties(env.physical_device, &mem_props);
+    uint32_t memory_type = 0;
+    while (!(mem_reqs.memoryTypeBits & (1u << memory_type))) memory_type++;
+
+    VkDeviceMemory memory;
+    vk_check(vkAllocateMemory(env.device, ptr_to(VkMemoryAllocateInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = mem_reqs.size,
+        .memoryTypeIndex = memory_type,
+    }), nullptr, &memory));
+    defer { vkFreeMemory(env.device, memory, nullptr); };
+    vk_check(vkBindImageMemory(env.device, image, memory, 0));
+
+    vkwsi_present_source source {
+        .image = image,
+        .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .extent = render_extent,
+        .format = window.info.format,
+        .filter = VK_FILTER_LINEAR,
+    };
+
+    // Renders to the offscreen image only, the library blits it into the acquired image
+
+    auto frame = [&](headless_window& target) {
+        wait_timeline(env, env.timeline_value);
+
+        VkSemaphoreSubmitInfo image_ready {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = env.timeline,
+            .value = ++env.timeline_value,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+        vk_check(vkwsi_swapchain_acquire(&target.swapchain, 1, env.queue, &image_ready, 1), VK_TIMEOUT);
+
+        vk_check(vkBeginCommandBuffer(env.cmd, ptr_to(VkCommandBufferBeginInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        })));
+        auto transition = [&](VkImageLayout old_layout, VkImageLayout new_layout) {
+            vkCmdPipelineBarrier2(env.cmd, ptr_to(VkDependencyInfo {
+                .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                .imageMemoryBarrierCount = 1,
+                .pImageMemoryBarriers = ptr_to(VkImageMemoryBarrier2 {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                    .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                    .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT,
+                    .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                    .dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT,
+                    .oldLayout = old_layout,
+                    .newLayout = new_layout,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = image,
+                    .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+                }),
+            }));
+        };
+        transition(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vkCmdClearColorImage(env.cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            ptr_to(VkClearColorValue{.float32{0.3f, 0.3f, 0.3f, 1.f}}),
+            1, ptr_to(VkImageSubresourceRange { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }));
+        transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vk_check(vkEndCommandBuffer(env.cmd));
+
+        VkSemaphoreSubmitInfo render_complete {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = env.timeline,
+            .value = ++env.timeline_value,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+        vk_check(vkQueueSubmit2(env.queue, 1, ptr_to(VkSubmitInfo2 {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+            .waitSemaphoreInfoCount = 1,
+            .pWaitSemaphoreInfos = &image_ready,
+            .commandBufferInfoCount = 1,
+            .pCommandBufferInfos = ptr_to(VkCommandBufferSubmitInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+                .commandBuffer = env.cmd,
+            }),
+            .signalSemaphoreInfoCount = 1,
+            .pSignalSemaphoreInfos = &render_complete,
+        }), nullptr));
+
+        vk_check(vkwsi_swapchain_present_image(&target.swapchain, 1, env.queue, &source, &render_complete, 1, false));
+    };
+
+    for (uint32_t i = 0; i < 16; ++i) frame(window);
+
+    // Window resizes don't change what is rendered, only how it is scaled
+
+    vk_check(vkwsi_swapchain_resize(window.swapchain, { 200, 300 }));
+    for (uint32_t i = 0; i < 16; ++i) frame(window);
+
+    // Shared images are presented again without waiting for their previous present, so the blit must wait for its
+    // previous submission instead. Alternating the filter re-records it on every frame.
+
+    auto shared = create_window(env, env.context, { 256, 256 }, VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR);
+    defer { destroy_window(env, shared); };
+    if (shared.info.present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR) {
+        for (uint32_t i = 0; i < 16; ++i) {
+            source.filter = i % 4 < 2 ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+            frame(shared);
+        }
+    }
+
+    wait_timeline(env, env.timeline_value);
+}
+
+static
+void test_damage(headless_env& env)
+{
+    headless_window windows[] {
+        create_window(env, env.context, { 256, 256 }),
+        create_window(env, env.context, { 128, 64 }),
+    };
+    defer { for (auto& w : windows) destroy_window(env, w); };
+
+    vkwsi_swapchain* swapchains[] { windows[0].swapchain, windows[1].swapchain };
+
+    // Damage on only some swapchains, some presents, and across a resize. Ignored if incremental present is unsupported
+
+    for (uint32_t i = 0; i < 32; ++i) {
+        if (i == 16) vk_check(vkwsi_swapchain_resize(windows[0].swapchain, { 192, 192 }));
+
+        auto value = render_frame(env, swapchains);
+        if (i % 4 != 3) {
+            VkRectLayerKHR rects[] {
+                { .offset = { 8, 8 }, .extent = { 32, 16 } },
+                { .offset = { 40, 24 }, .extent = { 16, 16 } },
+            };
+            vkwsi_swapchain_set_damage(windows[0].swapchain, rects, i % 2 ? 1 : 2);
+        }
+        vk_check(present_frame(env, swapchains, value, false));
+
+        // Damage without an acquired image is ignored and doesn't carry over to the next present
+        if (i % 8 == 5) {
+            VkRectLayerKHR stale { .offset = { 0, 0 }, .extent = { 4, 4 } };
+            vkwsi_swapchain_set_damage(windows[1].swapchain, &stale, 1);
+        }
+    }
+}
+
+static
+void test_idle(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    auto frame = [&](bool unchanged) {
+        if (unchanged) vkwsi_swapchain_mark_unchanged(window.swapchain);
+        VkResult acquire_result;
+        auto value = render_frame(env, { &window.swapchain, 1 }, &acquire_result);
+        bool acquired = vkwsi_swapchain_get_current(window.swapchain).image;
+        expect(acquired == (acquire_result == VK_SUCCESS));
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        return acquired;
+    };
+
+    for (uint32_t i = 0; i < 4; ++i) expect(frame(false));
+
+    // Unchanged frames are skipped entirely, and only apply to a single acquire
+
+    for (uint32_t i = 0; i < 4; ++i) expect(!frame(true));
+    expect(frame(false));
+
+    // Recreation always acquires
+
+    vk_check(vkwsi_swapchain_resize(window.swapchain, { 128, 128 }));
+    expect(frame(true));
+    expect(!frame(true));
+
+    // Keep-alive presents again once the interval has passed
+
+    vkwsi_swapchain_set_keep_alive(window.swapchain, std::chrono::nanoseconds(20ms).count());
+    expect(frame(false));
+    expect(!frame(true));
+    std::this_thread::sleep_for(25ms);
+    expect(frame(true));
+    expect(!frame(true));
+}
+
+static
+void test_shared_present(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 }, VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR);
+    defer { destroy_window(env, window); };
+
+    if (window.info.present_mode != VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR) {
+        log_warn("Shared present modes not supported, skipping");
+        return;
+    }
+
+    auto frame = [&] {
+        auto value = render_frame(env, { &window.swapchain, 1 }, nullptr, VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR);
+        auto current = vkwsi_swapchain_get_current(window.swapchain);
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        return current;
+    };
+
+    // The single image is handed out again on every acquire, until the swapchain is recreated
+
+    auto first = frame();
+    expect(first.image);
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto current = frame();
+        expect(current.image == first.image && current.version == first.version);
+    }
+
+    vk_check(vkwsi_swapchain_resize(window.swapchain, { 128, 128 }));
+    auto resized = frame();
+    expect(resized.image && resized.version != first.version);
+    for (uint32_t i = 0; i < 16; ++i) expect(frame().image == resized.image);
+
+    // Presents don't wait for the previous one, but every present still retires, and replaced user data is only
+    // destroyed once the image's presents have completed
+
+    auto count_callbacks = [](uint32_t* counts) {
+        return vkwsi_image_data_callbacks {
+            .create = [](void* data, vkwsi_swapchain*, const vkwsi_swapchain_image*, void** user_data) {
+                static_cast<uint32_t*>(data)[0]++;
+                *user_data = data;
+                return VK_SUCCESS;
+            },
+            .destroy = [](void* data, vkwsi_swapchain*, void*) {
+                static_cast<uint32_t*>(data)[1]++;
+            },
+            .data = counts,
+        };
+    };
+    uint32_t counts[2] {};
+    auto callbacks = count_callbacks(counts);
+    vkwsi_swapchain_set_image_data_callbacks(window.swapchain, &callbacks);
+    for (uint32_t i = 0; i < 4; ++i) frame();
+    expect(counts[0] == 1 && counts[1] == 0);
+
+    uint32_t new_counts[2] {};
+    auto new_callbacks = count_callbacks(new_counts);
+    vkwsi_swapchain_set_image_data_callbacks(window.swapchain, &new_callbacks);
+    frame();
+    expect(counts[1] == 1 && new_counts[0] == 1);
+
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+    auto retired = vkwsi_swapchain_get_retired(window.swapchain);
+    for (uint32_t i = 0; i < 8; ++i) frame();
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+    expect(vkwsi_swapchain_get_retired(window.swapchain) == retired + 8);
+
+    vkwsi_swapchain_set_image_data_callbacks(window.swapchain, nullptr);
+    expect(new_counts[1] == 1);
+}
+
+static
+void test_present_timing(headless_env& env)
+{
+    vkwsi_present_prediction prediction;
+
+    // Only FIFO presents are timed
+
+    {
+        auto window = create_window(env, env.context, { 256, 256 }, VK_PRESENT_MODE_MAILBOX_KHR);
+        defer { destroy_window(env, window); };
+
+        for (uint32_t i = 0; i < 32; ++i) {
+            vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+            auto value = render_frame(env, { &window.swapchain, 1 });
+            vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        }
+        vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+
+        if (window.info.present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            expect(vkwsi_swapchain_predict_next_present(window.swapchain, &prediction) == VK_NOT_READY);
+        }
+    }
+
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    expect(vkwsi_swapchain_predict_next_present(window.swapchain, &prediction) == VK_NOT_READY);
+
+    for (uint32_t i = 0; i < 64; ++i) {
+        vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+    }
+    vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+
+    // NOTE: Headless surfaces have no display, presents may complete too quickly to be timed
+
+    if (vkwsi_swapchain_predict_next_present(window.swapchain, &prediction) != VK_SUCCESS) {
+        log_warn("Presents not timed, skipping");
+        return;
+    }
+
+    auto now = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    log_info("Estimated refresh interval: {} us", prediction.refresh_interval_ns / 1000);
+    expect(prediction.refresh_interval_ns >= 1'000'000);
+    expect(prediction.next_refresh_ns + prediction.refresh_interval_ns > now);
+    expect(prediction.next_present_ns >= prediction.next_refresh_ns);
+}
+
+static
+void test_refresh_estimation(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    auto present = [&] {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        vk_check(vkwsi_swapchain_wait_for_latency(window.swapchain, 0));
+    };
+
+    auto now_ns = [] {
+        return int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+
+    // FIFO completions at 60Hz with up to 1ms of jitter either way, missing every fifth refresh. The newest is just
+    // under a refresh ago.
+
+    constexpr int64_t interval = 16'666'667;
+    constexpr int64_t max_jitter = 1'000'000;
+
+    auto add_samples = [&] {
+        int64_t base = now_ns() - 48 * interval;
+        uint32_t seed = 1;
+        for (int64_t n = 0; n < 48; ++n) {
+            seed = seed * 1664525 + 1013904223;
+            int64_t jitter = int64_t(seed >> 8) % (2 * max_jitter + 1) - max_jitter;
+            if (n % 5 != 4) vkwsi_swapchain_add_timing_sample(window.swapchain, uint64_t(base + n * interval + jitter));
+        }
+        return base;
+    };
+
+    present();
+    auto base = add_samples();
+    auto now = now_ns();
+
+    vkwsi_present_prediction prediction;
+    expect(vkwsi_swapchain_predict_next_present(window.swapchain, &prediction) == VK_SUCCESS);
+
+    int64_t estimated = int64_t(prediction.refresh_interval_ns);
+    log_info("Estimated refresh interval: {} ns", estimated);
+    expect(std::abs(estimated - interval) < 100'000);
+
+    // The next refresh is on the synthetic grid, within the jitter
+
+    auto next_refresh = int64_t(prediction.next_refresh_ns);
+    auto offset = (next_refresh - base) % interval;
+    expect(std::min(offset, interval - offset) < max_jitter);
+    expect(next_refresh > now && next_refresh <= now + interval + max_jitter);
+
+    // Estimation starts over when the swapchain is recreated
+
+    vk_check(vkwsi_swapchain_resize(window.swapchain, { 128, 128 }));
+    present();
+    expect(vkwsi_swapchain_predict_next_present(window.swapchain, &prediction) == VK_NOT_READY);
+
+    // And when the present mode changes, with or without recreating the swapchain
+
+    add_samples();
+    expect(vkwsi_swapchain_predict_next_present(window.swapchain, &prediction) == VK_SUCCESS);
+
+    auto info = window.info;
+    info.present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    vkwsi_swapchain_set_info(window.swapchain, &info);
+    vkwsi_swapchain_set_info(window.swapchain, &window.info);
+    present();
+    expect(vkwsi_swapchain_predict_next_present(window.swapchain, &prediction) == VK_NOT_READY);
+}
+
+static
+void test_present_scheduling(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    bool display_timing = std::ranges::any_of(env.device_extensions, [](const char* ext) {
+        return !std::strcmp(ext, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    });
+
+    auto now_ns = [] {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+
+    struct image_present
+    {
+        uint64_t id;
+        uint64_t issued_ns;
+    };
+
+    std::unordered_map<uint32_t, image_present> image_presents;
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+
+        // Each image reports the ID of its previous present, and when it was shown if known
+
+        auto current = vkwsi_swapchain_get_current(window.swapchain);
+        auto previous = image_presents.find(current.index);
+        if (previous != image_presents.end()) {
+            expect(current.previous_present_id == previous->second.id);
+            expect(current.previous_present_time_ns == 0
+                || (current.previous_present_time_ns >= previous->second.issued_ns
+                    && current.previous_present_time_ns <= now_ns()));
+        } else {
+            expect(current.previous_present_id == 0 && current.previous_present_time_ns == 0);
+        }
+
+        uint64_t present_id = 100 + i;
+
+        // Without display timing, presents are held on the host until shortly before the desired time, and at most
+        // until just before the refresh after it
+
+        vkwsi_present_prediction prediction = {};
+        vkwsi_swapchain_predict_next_present(window.swapchain, &prediction);
+
+        uint64_t start = now_ns();
+        uint64_t desired = start + std::chrono::nanoseconds(5ms).count();
+        vkwsi_swapchain_set_present_timing(window.swapchain, ptr_to(vkwsi_present_timing {
+            .present_id = present_id,
+            .desired_present_ns = desired,
+        }));
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        image_presents[current.index] = { present_id, start };
+
+        if (!display_timing) {
+            uint64_t end = now_ns();
+            expect(end + prediction.refresh_interval_ns >= desired);
+            expect(end <= desired + prediction.refresh_interval_ns + std::chrono::nanoseconds(50ms).count());
+        }
+    }
+
+    // Desired times far in the future (e.g. from the wrong time base) only hold the present for a bounded time
+
+    if (!display_timing) {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        uint64_t start = now_ns();
+        vkwsi_swapchain_set_present_timing(window.swapchain, ptr_to(vkwsi_present_timing {
+            .desired_present_ns = start + std::chrono::nanoseconds(10s).count(),
+        }));
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        expect(now_ns() - start < uint64_t(std::chrono::nanoseconds(1s).count()));
+    }
+}
+
+static
+void test_present_mode_switch(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    auto present = [&] {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+    };
+
+    present();
+    auto version = vkwsi_swapchain_get_current(window.swapchain).version;
+
+    VkPresentModeKHR compatible_modes[16];
+    VkSurfacePresentModeCompatibilityEXT compat {
+        .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_COMPATIBILITY_EXT,
+        .presentModeCount = uint32_t(std::size(compatible_modes)),
+        .pPresentModes = compatible_modes,
+    };
+    vk_check(vkGetPhysicalDeviceSurfaceCapabilities2KHR(env.physical_device, ptr_to(VkPhysicalDeviceSurfaceInfo2KHR {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR,
+        .pNext = ptr_to(VkSurfacePresentModeKHR {
+            .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_KHR,
+            .presentMode = window.info.present_mode,
+        }),
+        .surface = window.surface,
+    }), ptr_to(VkSurfaceCapabilities2KHR {
+        .sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR,
+        .pNext = &compat,
+    })));
+
+    // The swapchain must have enough images for every mode it can be switched to
+
+    for (uint32_t i = 0; i < compat.presentModeCount; ++i) {
+        VkSurfaceCapabilities2KHR caps {
+            .sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR,
+        };
+        vk_check(vkGetPhysicalDeviceSurfaceCapabilities2KHR(env.physical_device, ptr_to(VkPhysicalDeviceSurfaceInfo2KHR {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR,
+            .pNext = ptr_to(VkSurfacePresentModeKHR {
+                .sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_KHR,
+                .presentMode = compatible_modes[i],
+            }),
+            .surface = window.surface,
+        }), &caps));
+        expect(injector.swapchain_min_image_count >= caps.surfaceCapabilities.minImageCount);
+    }
+
+    // Switching between compatible modes must not recreate the swapchain
+
+    for (uint32_t i = 0; i < compat.presentModeCount; ++i) {
+        auto info = window.info;
+        info.present_mode = compatible_modes[i];
+        vkwsi_swapchain_set_info(window.swapchain, &info);
+        present();
+        expect(vkwsi_swapchain_get_current(window.swapchain).version == version);
+    }
+
+    // Changing any other property still recreates
+
+    auto info = window.info;
+    info.min_image_count++;
+    vkwsi_swapchain_set_info(window.swapchain, &info);
+    present();
+    expect(vkwsi_swapchain_get_current(window.swapchain).version != version);
+}
+
+static
+void test_release(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    // Acquire and release far more images than the swapchain holds, this would stall without the release
+
+    for (uint32_t i = 0; i < 32; ++i) {
+        VkSemaphoreSubmitInfo image_ready {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = env.timeline,
+            .value = ++env.timeline_value,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        };
+        vk_check(vkwsi_swapchain_acquire(&window.swapchain, 1, env.queue, &image_ready, 1));
+        // No work of our own uses the image, the library waits for its acquire submission itself
+        vk_check(vkwsi_swapchain_release(&window.swapchain, 1));
+
+        if (i % 4 == 0) {
+            auto value = render_frame(env, { &window.swapchain, 1 });
+            vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        }
+    }
+}
+
+static
+void test_zero_extent_parking(headless_env& env)
+{
+    headless_window windows[] {
+        create_window(env, env.context, { 256, 256 }),
+        create_window(env, env.context, { 64, 64 }),
+    };
+    defer { for (auto& w : windows) destroy_window(env, w); };
+
+    vkwsi_swapchain* swapchains[] { windows[0].swapchain, windows[1].swapchain };
+
+    auto frame = [&] {
+        VkResult acquire_result;
+        auto value = render_frame(env, swapchains, &acquire_result);
+        vk_check(present_frame(env, swapchains, value, false));
+        return acquire_result;
+    };
+
+    auto now_ns = [] {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+
+    expect(frame() == VK_SUCCESS);
+    expect(vkwsi_swapchain_get_park_retry_time(windows[0].swapchain) == 0);
+
+    // Minimize one window, the other must keep presenting
+
+    vk_check(vkwsi_swapchain_resize(windows[0].swapchain, { 0, 0 }));
+    for (uint32_t i = 0; i < 8; ++i) {
+        expect(frame() == VK_TIMEOUT);
+        expect(!vkwsi_swapchain_get_current(windows[0].swapchain).image);
+        expect(vkwsi_swapchain_get_current(windows[1].swapchain).image);
+    }
+
+    // Minimize both, acquire returns immediately and backing off is left to the caller
+
+    vk_check(vkwsi_swapchain_resize(windows[1].swapchain, { 0, 0 }));
+    uint64_t last_retry_ns = 0;
+    for (uint32_t i = 0; i < 8; ++i) {
+        expect(frame() == VK_TIMEOUT);
+
+        auto retry_ns = std::min(vkwsi_swapchain_get_park_retry_time(windows[0].swapchain),
+            vkwsi_swapchain_get_park_retry_time(windows[1].swapchain));
+        expect(retry_ns > now_ns() - std::chrono::nanoseconds(1ms).count());
+        expect(retry_ns >= last_retry_ns);
+        last_retry_ns = retry_ns;
+
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(retry_ns)));
+    }
+
+    // Restore
+
+    vk_check(vkwsi_swapchain_resize(windows[0].swapchain, { 128, 128 }));
+    vk_check(vkwsi_swapchain_resize(windows[1].swapchain, { 64, 64 }));
+    frame();
+    expect(vkwsi_swapchain_get_current(windows[0].swapchain).extent.width == 128);
+    expect(vkwsi_swapchain_get_current(windows[1].swapchain).image);
+}
+
+static
+void test_cross_thread_resize(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    auto frame = [&] {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+    };
+
+    frame();
+
+    // Post resizes and info updates from an "event" thread while rendering, as a window system would
+
+    std::atomic<bool> done = false;
+    std::jthread events([&] {
+        for (uint32_t i = 0; i < 256; ++i) {
+            vk_check(vkwsi_swapchain_resize(window.swapchain, { 64 + (i % 32) * 8, 64 + (i % 16) * 8 }));
+            if (i % 32 == 0) {
+                auto info = window.info;
+                info.min_image_count = 2 + (i / 32) % 2;
+                vkwsi_swapchain_set_info(window.swapchain, &info);
+            }
+            std::this_thread::sleep_for(100us);
+        }
+        vk_check(vkwsi_swapchain_resize(window.swapchain, { 200, 100 }));
+        done = true;
+    });
+
+    while (!done) frame();
+    events.join();
+
+    // Only the latest update is applied
+
+    frame();
+    auto current = vkwsi_swapchain_get_current(window.swapchain);
+    expect(current.extent.width == 200 && current.extent.height == 100);
+}
+
+static
+void test_adaptive_image_count(headless_env& env)
+{
+    // Every acquire is delayed past the stall threshold for a while, then acquires stop stalling
+
+    vkwsi_simulator* sim;
+    vk_check(vkwsi_simulator_create(&sim, "at 0 acquire_delay 2\nat 384 acquire_delay 0\n", { .fn = log_vkwsi_message }));
+    defer { vkwsi_simulator_destroy(sim); };
+
+    auto context_info = make_context_info(env);
+    context_info.simulator = sim;
+
+    vkwsi_context* context;
+    vk_check(vkwsi_context_create(&context, &context_info));
+    defer { vkwsi_context_destroy(context); };
+
+    auto window = create_window(env, context, { 256, 256 }, VK_PRESENT_MODE_MAILBOX_KHR);
+    defer { destroy_window(env, window); };
+
+    if (window.info.present_mode != VK_PRESENT_MODE_MAILBOX_KHR) {
+        log_warn("MAILBOX not supported, skipping");
+        return;
+    }
+
+    auto info = window.info;
+    info.adaptive_image_count = true;
+    vkwsi_swapchain_set_info(window.swapchain, &info);
+
+    VkSurfaceCapabilitiesKHR caps;
+    vk_check(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(env.physical_device, window.surface, &caps));
+    // NOTE: Surfaces without a limit are bounded by VKWSI_ADAPTIVE_MAX_IMAGE_COUNT, 8 by default
+    uint32_t max_image_count = caps.maxImageCount ? caps.maxImageCount : 8;
+
+    auto frame = [&] {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        expect(injector.swapchain_min_image_count <= max_image_count);
+    };
+
+    frame();
+    auto initial_count = injector.swapchain_min_image_count;
+
+    for (uint32_t i = 1; i < 384; ++i) frame();
+    auto grown_count = injector.swapchain_min_image_count;
+    expect(grown_count > initial_count || initial_count == max_image_count);
+
+    // Shrinks again after SHRINK_WINDOWS windows without stalls
+
+    for (uint32_t i = 384; i < 1152; ++i) frame();
+    expect(injector.swapchain_min_image_count < grown_count || grown_count == initial_count);
+}
+
+static
+void test_headless_swapchain(headless_env& env)
+{
+    vkwsi_swapchain* swapchain;
+    vk_check(vkwsi_swapchain_create_headless(&swapchain, env.context));
+    defer { vkwsi_swapchain_destroy(swapchain); };
+
+    auto info = vkwsi_swapchain_info_default();
+    info.image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    info.format = VK_FORMAT_B8G8R8A8_UNORM;
+    info.color_space = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    vkwsi_swapchain_set_info(swapchain, &info);
+    vk_check(vkwsi_swapchain_resize(swapchain, { 320, 240 }));
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        auto value = render_frame(env, { &swapchain, 1 });
+        vk_check(present_frame(env, { &swapchain, 1 }, value, false));
+    }
+
+    expect(vkwsi_swapchain_get_current(swapchain).extent.width == 320);
+}
+
+static
+void test_injected_out_of_date(headless_env& env)
+{
+    auto window = create_window(env, env.context, { 256, 256 });
+    defer { destroy_window(env, window); };
+
+    auto frame = [&] {
+        auto value = render_frame(env, { &window.swapchain, 1 });
+        vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        return vkwsi_swapchain_get_current(window.swapchain).version;
+    };
+
+    auto version = frame();
+
+    // OUT_OF_DATE from present recreates on the next acquire
+
+    injector.present_out_of_date = 1;
+    expect(frame() == version);
+    expect(frame() == version + 1);
+    version++;
+
+    // Transient OUT_OF_DATE from acquire is retried within the same acquire
+
+    injector.acquire_out_of_date = 2;
+    expect(frame() == version + 2);
+    version += 2;
+
+    // SUBOPTIMAL is not an error and does not force recreation
+
+    injector.acquire_suboptimal = 1;
+    injector.present_suboptimal = 1;
+    expect(frame() == version);
+    expect(frame() == version);
+
+    // Persistent OUT_OF_DATE parks the swapchain until it recovers
+
+    injector.acquire_out_of_date = 1000;
+    auto value = render_frame(env, { &window.swapchain, 1 });
+    expect(!vkwsi_swapchain_get_current(window.swapchain).image);
+    vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+
+    injector.acquire_out_of_date = 0;
+    vk_check(vkwsi_swapchain_resize(window.swapchain, { 200, 200 }));
+    frame();
+    expect(vkwsi_swapchain_get_current(window.swapchain).extent.width == 200);
+}
+
+// Runs every scenario in `VKWSI_TEST_SCENARIO_DIR` against the simulated presentation engine and reports recovery latency
+static
+void test_simulator_scenarios(headless_env& env)
+{
+    std::vector<std::filesystem::path> scenarios;
+    for (auto& entry : std::filesystem::directory_iterator(VKWSI_TEST_SCENARIO_DIR)) {
+        if (entry.path().extension() == ".txt") scenarios.emplace_back(entry.path());
+    }
+    std::ranges::sort(scenarios);
+    expect(!scenarios.empty());
+
+    for (auto& path : scenarios) {
+        std::stringstream scenario;
+        scenario << std::ifstream(path).rdbuf();
+
+        vkwsi_simulator* sim;
+        vk_check(vkwsi_simulator_create(&sim, scenario.str().c_str(), { .fn = log_vkwsi_message }));
+        defer { vkwsi_simulator_destroy(sim); };
+
+        auto info = make_context_info(env);
+        info.simulator = sim;
+
+        vkwsi_context* context;
+        vk_check(vkwsi_context_create(&context, &info));
+        defer { vkwsi_context_destroy(context); };
+
+        std::vector<headless_window> windows;
+        std::vector<vkwsi_swapchain*> swapchains;
+        defer { for (auto& w : windows) destroy_window(env, w); };
+        for (uint32_t i = 0; i < vkwsi_simulator_get_window_count(sim); ++i) {
+            windows.emplace_back(create_window(env, context, { 256, 256 }));
+            swapchains.emplace_back(windows.back().swapchain);
+        }
+
+        for (uint64_t frame = 0; frame < vkwsi_simulator_get_frame_count(sim); ++frame) {
+            auto extent = vkwsi_simulator_get_window_extent(sim);
+            if (extent.width && extent.height) {
+                for (auto* swapchain : swapchains) vk_check(vkwsi_swapchain_resize(swapchain, extent));
+            }
+
+            auto value = render_frame(env, swapchains);
+            vk_check(present_frame(env, swapchains, value, false));
+        }
+
+        wait_timeline(env, env.timeline_value);
+
+        auto stats = vkwsi_simulator_get_stats(sim);
+        auto recovered = std::max(stats.recovered_resizes, 1u);
+        log_info("  {}: {} frames, {}/{} resizes recovered in {:.1f} frames / {:.2f} ms avg, {} frames / {:.2f} ms max, {} OUT_OF_DATE, {} SUBOPTIMAL",
+            path.stem().string(), stats.frames,
+            stats.recovered_resizes, stats.resizes,
+            double(stats.total_recovery_frames) / recovered, stats.total_recovery_ns / 1e6 / recovered,
+            stats.max_recovery_frames, stats.max_recovery_ns / 1e6,
+            stats.injected_out_of_date, stats.injected_suboptimal);
+
+        expect(stats.deadlocks == 0);
+        expect(stats.resizes == 0 || stats.recovered_resizes > 0);
+    }
+}
+
+// NOTE: Tracks every live allocation made through the callbacks, by vk-wsi and by the driver
+struct allocation_tracker
+{
+    std::mutex mutex;
+    std::unordered_map<void*, size_t> live;
+    uint64_t allocations = 0;
+    size_t peak_bytes = 0;
+    size_t bytes = 0;
+
+    // Fails the allocation attempt with this index
+    uint64_t attempts = 0;
+    uint64_t fail_at = UINT64_MAX;
+};
+
+static
+VKAPI_ATTR void* VKAPI_CALL tracked_allocate(void* user, size_t size, size_t alignment, VkSystemAllocationScope)
+{
+    auto& tracker = *static_cast<allocation_tracker*>(user);
+    {
+        std::scoped_lock lock { tracker.mutex };
+        if (tracker.attempts++ == tracker.fail_at) return nullptr;
+    }
+
+    auto ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (!ptr) return nullptr;
+
+    std::scoped_lock lock { tracker.mutex };
+    tracker.live[ptr] = size;
+    tracker.allocations++;
+    tracker.bytes += size;
+    tracker.peak_bytes = std::max(tracker.peak_bytes, tracker.bytes);
+    return ptr;
+}
+
+static
+VKAPI_ATTR void VKAPI_CALL tracked_free(void* user, void* ptr)
+{
+    if (!ptr) return;
+    auto& tracker = *static_cast<allocation_tracker*>(user);
+    {
+        std::scoped_lock lock { tracker.mutex };
+        auto iter = tracker.live.find(ptr);
+        expect(iter != tracker.live.end());
+        tracker.bytes -= iter->second;
+        tracker.live.erase(iter);
+    }
+    std::free(ptr);
+}
+
+static
+VKAPI_ATTR void* VKAPI_CALL tracked_reallocate(void* user, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (!size) {
+        tracked_free(user, original);
+        return nullptr;
+    }
+    auto ptr = tracked_allocate(user, size, alignment, scope);
+    if (ptr && original) {
+        auto& tracker = *static_cast<allocation_tracker*>(user);
+        size_t original_size;
+        {
+            std::scoped_lock lock { tracker.mutex };
+            original_size = tracker.live.at(original);
+        }
+        std::memcpy(ptr, original, std::min(original_size, size));
+        tracked_free(user, original);
+    }
+    return ptr;
+}
+
+static
+void test_allocation_callbacks(headless_env& env)
+{
+    allocation_tracker tracker;
+
+    {
+        VkAllocationCallbacks callbacks {
+            .pUserData = &tracker,
+            .pfnAllocation = tracked_allocate,
+            .pfnReallocation = tracked_reallocate,
+            .pfnFree = tracked_free,
+        };
+
+        auto info = make_context_info(env);
+        info.allocation_callbacks = &callbacks;
+
+        vkwsi_context* context;
+        vk_check(vkwsi_context_create(&context, &info));
+        defer { vkwsi_context_destroy(context); };
+
+        // The callbacks are copied, and need not outlive context creation
+        callbacks = {};
+
+        auto window = create_window(env, context, { 256, 256 });
+        defer { destroy_window(env, window); };
+
+        for (uint32_t i = 0; i < 8; ++i) {
+            auto value = render_frame(env, { &window.swapchain, 1 });
+            vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        }
+
+        wait_timeline(env, env.timeline_value);
+
+        expect(tracker.bytes > 0);
+    }
+
+    log_info("  {} allocations, {} bytes peak", tracker.allocations, tracker.peak_bytes);
+
+    expect(tracker.live.empty());
+
+    // Failed context creation frees everything it allocated
+
+    {
+        VkAllocationCallbacks callbacks {
+            .pUserData = &tracker,
+            .pfnAllocation = tracked_allocate,
+            .pfnReallocation = tracked_reallocate,
+            .pfnFree = tracked_free,
+        };
+
+        auto path = (std::filesystem::temp_directory_path() / "vk-wsi-missing" / "session.vkwsirec").string();
+
+        auto info = make_context_info(env);
+        info.allocation_callbacks = &callbacks;
+        info.record_path = path.c_str();
+
+        vkwsi_context* context = nullptr;
+        expect(vkwsi_context_create(&context, &info) != VK_SUCCESS);
+        expect(!context);
+    }
+
+    expect(tracker.live.empty());
+
+    // Allocation failures during context creation are reported, not thrown
+
+    for (uint64_t fail_at = 0;; ++fail_at) {
+        VkAllocationCallbacks callbacks {
+            .pUserData = &tracker,
+            .pfnAllocation = tracked_allocate,
+            .pfnReallocation = tracked_reallocate,
+            .pfnFree = tracked_free,
+        };
+
+        tracker.attempts = 0;
+        tracker.fail_at = fail_at;
+
+        auto info = make_context_info(env);
+        info.allocation_callbacks = &callbacks;
+        info.acquire_thread_count = 3;
+
+        vkwsi_context* context = nullptr;
+        auto res = vkwsi_context_create(&context, &info);
+        tracker.fail_at = UINT64_MAX;
+
+        if (res == VK_SUCCESS) {
+            vkwsi_context_destroy(context);
+            expect(tracker.live.empty());
+            break;
+        }
+
+        expect(res == VK_ERROR_OUT_OF_HOST_MEMORY);
+        expect(tracker.live.empty());
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+struct replay_stats
+{
+    uint32_t calls;
+    uint32_t mismatches;
+    uint64_t total_lateness_ns;
+    uint64_t max_lateness_ns;
+};
+
+// NOTE: Replays a recording made with `vkwsi_context_info::record_path`. The driver results in the recording are
+//       converted into a simulator scenario (the simulator keys events on present count, as the recording does), and
+//       the API calls are re-issued against it, optionally sleeping to reproduce the recorded call timing.
+static
+replay_stats replay_recording(headless_env& env, const char* path, bool preserve_timing)
+{
+    struct replay_record
+    {
+        vkwsi_record record;
+        std::vector<uint32_t> swapchains;
+    };
+
+    std::vector<replay_record> records;
+    {
+        vkwsi_record_reader* reader;
+        vk_check(vkwsi_record_reader_open(&reader, path));
+        defer { vkwsi_record_reader_close(reader); };
+
+        vkwsi_record record;
+        while (vk_check(vkwsi_record_reader_next(reader, &record), VK_INCOMPLETE) == VK_SUCCESS) {
+            auto& r = records.emplace_back(record, std::vector(record.swapchains, record.swapchains + record.swapchain_count));
+            r.record.swapchains = r.swapchains.data();
+        }
+    }
+
+    std::string scenario;
+    uint32_t window_count = 0;
+    uint64_t frame_count = 0;
+    for (auto& [record, ids] : records) {
+        auto result = record.result == VK_ERROR_OUT_OF_DATE_KHR ? "out_of_date"
+                    : record.result == VK_SUBOPTIMAL_KHR        ? "suboptimal"
+                    : nullptr;
+        switch (record.type) {
+            break;case vkwsi_record_type_swapchain_create:
+                window_count++;
+            break;case vkwsi_record_type_swapchain_present:
+                frame_count++;
+            break;case vkwsi_record_type_driver_acquire:
+                if (result) scenario += std::format("at {} {} acquire\n", record.frame, result);
+            break;case vkwsi_record_type_driver_present:
+                if (result) scenario += std::format("at {} {} present\n", record.frame, result);
+            break;case vkwsi_record_type_driver_surface_extent:
+                scenario += std::format("at {} surface {} {}\n", record.frame, record.extent.width, record.extent.height);
+            break;default:
+                ;
+        }
+    }
+    scenario += std::format("windows {}\nframes {}\n", std::max(window_count, 1u), frame_count);
+
+    vkwsi_simulator* sim;
+    vk_check(vkwsi_simulator_create(&sim, scenario.c_str(), { .fn = log_vkwsi_message }));
+    defer { vkwsi_simulator_destroy(sim); };
+
+    auto info = make_context_info(env);
+    info.simulator = sim;
+
+    vkwsi_context* context;
+    vk_check(vkwsi_context_create(&context, &info));
+    defer { vkwsi_context_destroy(context); };
+
+    std::vector<headless_window> windows;
+    defer { for (auto& w : windows) if (w.swapchain) destroy_window(env, w); };
+
+    replay_stats stats = {};
+    uint64_t render_complete = env.timeline_value;
+    std::vector<vkwsi_swapchain*> swapchains;
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& [record, ids] : records) {
+        if (record.type >= vkwsi_record_type_driver_acquire) continue;
+
+        auto target = start + std::chrono::nanoseconds(record.time);
+        if (preserve_timing) std::this_thread::sleep_until(target);
+        auto lateness = uint64_t(std::max(std::chrono::nanoseconds(std::chrono::steady_clock::now() - target).count(), int64_t(0)));
+        stats.total_lateness_ns += lateness;
+        stats.max_lateness_ns = std::max(stats.max_lateness_ns, lateness);
+        stats.calls++;
+
+        swapchains.clear();
+        for (auto id : ids) swapchains.emplace_back(id < windows.size() ? windows[id].swapchain : nullptr);
+        expect(std::ranges::find(swapchains, nullptr) == swapchains.end());
+
+        VkResult res = VK_SUCCESS;
+        switch (record.type) {
+            break;case vkwsi_record_type_swapchain_create: {
+                auto& window = windows.emplace_back();
+                vk_check(env.vkCreateHeadlessSurfaceEXT(env.instance, ptr_to(VkHeadlessSurfaceCreateInfoEXT {
+                    .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+                }), nullptr, &window.surface));
+                vk_check(vkwsi_swapchain_create(&window.swapchain, context, window.surface));
+            }
+            break;case vkwsi_record_type_swapchain_destroy:
+                destroy_window(env, windows[ids[0]]);
+            break;case vkwsi_record_type_swapchain_set_info: {
+                // Queue families aren't recorded, substitute our own
+                auto& window = windows[ids[0]];
+                window.info = record.info;
+                window.info.queue_families = &env.queue_family;
+                window.info.queue_family_count = std::min(window.info.queue_family_count, 1u);
+                vkwsi_swapchain_set_info(window.swapchain, &window.info);
+            }
+            break;case vkwsi_record_type_swapchain_resize:
+                res = vkwsi_swapchain_resize(swapchains[0], record.extent);
+            break;case vkwsi_record_type_swapchain_acquire:
+                render_complete = render_frame(env, swapchains, &res);
+            break;case vkwsi_record_type_swapchain_present:
+                res = present_frame(env, swapchains, render_complete, record.host_wait);
+            break;case vkwsi_record_type_swapchain_release:
+                wait_timeline(env, render_complete);
+                res = vkwsi_swapchain_release(swapchains.data(), uint32_t(swapchains.size()));
+            break;default:
+                ;
+        }
+
+        bool has_result = record.type == vkwsi_record_type_swapchain_acquire
+            || record.type == vkwsi_record_type_swapchain_present
+            || record.type == vkwsi_record_type_swapchain_release;
+        if (has_result && res != record.result) {
+            log_warn("Replay mismatch at {:.3f} ms: call type {} returned {}, recorded {}",
+                record.time / 1e6, int(record.type), int(res), int(record.result));
+            stats.mismatches++;
+        }
+    }
+
+    wait_timeline(env, env.timeline_value);
+
+    return stats;
+}
+
+static
+void test_record_replay(headless_env& env)
+{
+    auto path = (std::filesystem::temp_directory_path() / "vk-wsi-headless-test.vkwsirec").string();
+    defer { std::filesystem::remove(path); };
+
+    // Record a session with driver faults and a surface resize
+
+    {
+        vkwsi_simulator* sim;
+        vk_check(vkwsi_simulator_create(&sim, R"(
+            at 0 surface 256 256
+            at 5 out_of_date present
+            at 10 suboptimal acquire
+            at 15 surface 200 200
+            at 20 out_of_date acquire 2
+            at 25 window 300 200
+        )", { .fn = log_vkwsi_message }));
+        defer { vkwsi_simulator_destroy(sim); };
+
+        auto info = make_context_info(env);
+        info.simulator = sim;
+        info.record_path = path.c_str();
+
+        vkwsi_context* context;
+        vk_check(vkwsi_context_create(&context, &info));
+        defer { vkwsi_context_destroy(context); };
+
+        auto window = create_window(env, context, { 256, 256 });
+        defer { destroy_window(env, window); };
+
+        for (uint32_t frame = 0; frame < 40; ++frame) {
+            auto extent = vkwsi_simulator_get_window_extent(sim);
+            if (extent.width && extent.height) vk_check(vkwsi_swapchain_resize(window.swapchain, extent));
+
+            auto value = render_frame(env, { &window.swapchain, 1 });
+            vk_check(present_frame(env, { &window.swapchain, 1 }, value, false));
+        }
+
+        wait_timeline(env, env.timeline_value);
+    }
+
+    auto stats = replay_recording(env, path.c_str(), true);
+    log_info("  replayed {} calls, {} mismatches, {:.3f} ms avg / {:.3f} ms max lateness",
+        stats.calls, stats.mismatches,
+        stats.total_lateness_ns / 1e6 / std::max(stats.calls, 1u), stats.max_lateness_ns / 1e6);
+
+    expect(stats.calls > 80);
+    expect(stats.mismatches == 0);
+}
+
+// -----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    // Usage: vk-wsi-headless-test [--replay <recording>]
+    const char* replay_path = nullptr;
+    if (argc == 3 && !std::strcmp(argv[1], "--replay")) {
+        replay_path = argv[2];
+    }
+
+    headless_env env;
+
+    if (!headless_env_create(env, 2)) return skip_return_code;
+    defer { headless_env_destroy(env); };
+
+    vk_check(vkwsi_context_create(&env.context, ptr_to(make_context_info(env))));
+    defer { vkwsi_context_destroy(env.context); };
+
+    // Make sure all work has completed before tearing down
+    defer { wait_timeline(env, env.timeline_value); };
+
+    if (replay_path) {
+        auto stats = replay_recording(env, replay_path, true);
+        log_info("Replayed {} calls, {} mismatches, {:.3f} ms avg / {:.3f} ms max lateness",
+            stats.calls, stats.mismatches,
+            stats.total_lateness_ns / 1e6 / std::max(stats.calls, 1u), stats.max_lateness_ns / 1e6);
+        return stats.mismatches ? 1 : 0;
+    }
+
+    struct test_case
+    {
+        const char* name;
+        void(*fn)(headless_env&);
+    };
+
+    test_case tests[] {
+        { "present_device_wait",   test_present_device_wait   },
+        { "present_host_wait",     test_present_host_wait     },
+        { "host_wait_timeout",     test_host_wait_timeout     },
+        { "async_present",         test_async_present         },
+        { "present_queues",        test_present_queues        },
+        { "parallel_acquire",      test_parallel_acquire      },
+        { "latency_limiter",       test_latency_limiter       },
+        { "retire_counter",        test_retire_counter        },
+        { "image_data",            test_image_data            },
+        { "layout_transitions",    test_layout_transitions    },
+        { "present_image",         test_present_image         },
+        { "damage",                test_damage                },
+        { "idle",                  test_idle                  },
+        { "shared_present",        test_shared_present        },
+        { "present_timing",        test_present_timing        },
+        { "refresh_estimation",    test_refresh_estimation    },
+        { "present_scheduling",    test_present_scheduling    },
+        { "present_mode_switch",   test_present_mode_switch   },
+        { "release",               test_release               },
+        { "zero_extent_parking",   test_zero_extent_parking   },
+        { "cross_thread_resize",   test_cross_thread_resize   },
+        { "adaptive_image_count",  test_adaptive_image_count  },
+        { "headless_swapchain",    test_headless_swapchain    },
+        { "injected_out_of_date",  test_injected_out_of_date  },
+        { "simulator_scenarios",   test_simulator_scenarios   },
+        { "allocation_callbacks",  test_allocation_callbacks  },
+        { "record_replay",         test_record_replay         },
+    };
+
+    for (auto& test : tests) {
+        log_info("Running test: {}", test.name);
+        test.fn(env);
+        wait_timeline(env, env.timeline_value);
+    }
+
+    log_info("All tests passed");
+
+    return 0;
+}
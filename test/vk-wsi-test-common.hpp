@@ -0,0 +1,116 @@
+#pragma once
+
+#include "vk-wsi.h"
+
+#include <format>
+#include <iostream>
+#include <source_location>
+#include <cstdlib>
+#include <concepts>
+
+// -----------------------------------------------------------------------------
+
+template<typename Fn>
+struct Defer
+{
+    Fn fn;
+
+    Defer(Fn&& fn): fn(std::move(fn)) {}
+    ~Defer() { fn(); };
+};
+
+// -----------------------------------------------------------------------------
+
+#define VKWSI_TEST_CONCAT_INTERNAL(a, b) a##b
+#define VKWSI_TEST_CONCAT(a, b) VKWSI_TEST_CONCAT_INTERNAL(a, b)
+#define VKWSI_TEST_UNIQUE_VAR() VKWSI_TEST_CONCAT(vkwsi_var_, __COUNTER__)
+
+#define defer Defer VKWSI_TEST_UNIQUE_VAR() = [&]
+
+#define VT_color_begin(color) "\u001B[" #color "m"
+#define VT_color_reset "\u001B[0m"
+#define VT_color(color, text) VT_color_begin(color) text VT_color_reset
+
+template<typename ...Args>
+void log_trace(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::cout << std::format("[" VT_color(90, "TRACE") "] " VT_color(90, "{}") "\n", std::vformat(fmt.get(), std::make_format_args(args...)));
+}
+
+template<typename ...Args>
+void log_debug(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::cout << std::format("[" VT_color(96, "DEBUG") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
+}
+
+template<typename ...Args>
+void log_info(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::cout << std::format(" [" VT_color(94, "INFO") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
+}
+
+template<typename ...Args>
+void log_warn(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::cout << std::format(" [" VT_color(93, "WARN") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
+}
+
+template<typename ...Args>
+void log_error(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::cout << std::format("[" VT_color(91, "ERROR") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
+}
+
+// -----------------------------------------------------------------------------
+
+template<typename... Args>
+[[noreturn]] void error(std::source_location loc, std::format_string<Args...> fmt, Args&& ...args)
+{
+    log_error("{}:{} :: {}", loc.file_name(), loc.line(), std::vformat(fmt.get(), std::make_format_args(args...)));
+    std::exit(1);
+}
+
+// -----------------------------------------------------------------------------
+
+struct LocatedVkResult
+{
+    VkResult res;
+    std::source_location loc;
+
+    LocatedVkResult(VkResult _res, std::source_location _loc = std::source_location::current())
+        : res(_res), loc(_loc)
+    {}
+};
+
+VkResult vk_check(LocatedVkResult located_res, auto... allowed)
+{
+    auto[res, loc] = located_res;
+    if (res == VK_SUCCESS || (... || (res == allowed))) return res;
+    error(loc, "VkResult = {}", int(res));
+}
+
+template<typename Container, typename Fn, typename... Args>
+void vk_enumerate(Container& container, Fn&& fn, Args&&... args)
+{
+    uint32_t count = static_cast<uint32_t>(container.size());
+    for (;;) {
+        uint32_t old_count = count;
+        if constexpr (std::same_as<VkResult, decltype(fn(args..., &count, nullptr))>) {
+            vk_check(fn(args..., &count, container.data()), VK_INCOMPLETE);
+        } else {
+            fn(args..., &count, container.data());
+        }
+
+        container.resize(count);
+        if (count <= old_count) return;
+    }
+}
+
+auto ptr_to(auto&& v) { return &v; }
+
+#define vk_instance_fn(fn) PFN_##fn fn = reinterpret_cast<PFN_##fn>(vkGetInstanceProcAddr(instance, #fn)); \
+    if (!fn) error(std::source_location::current(), "Instance function " #fn " failed to load!")
+
+#define vk_device_fn(fn) PFN_##fn fn = reinterpret_cast<PFN_##fn>(vkGetDeviceProcAddr(device, #fn)); \
+    if (!fn) error(std::source_location::current(), "Device function " #fn " failed to load!")
+
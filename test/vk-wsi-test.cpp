@@ -1,4 +1,4 @@
-#include "vk-wsi.h"
+#include "vk-wsi-test-common.hpp"
 
 #define VKWSI_TEST_USE_SDL 1
 #define VKWSI_TEST_USE_GLFW 0
@@ -38,120 +38,13 @@ extern "C" const char* __asan_default_options() { return "detect_leaks=0"; }
 
 // -----------------------------------------------------------------------------
 
-// TODO: Create a separate test harness to keep boilerplate clutter away from test/example logic
-
-template<typename Fn>
-struct Defer
-{
-    Fn fn;
-
-    Defer(Fn&& fn): fn(std::move(fn)) {}
-    ~Defer() { fn(); };
-};
-
-// -----------------------------------------------------------------------------
-
-#define VKWSI_TEST_CONCAT_INTERNAL(a, b) a##b
-#define VKWSI_TEST_CONCAT(a, b) VKWSI_TEST_CONCAT_INTERNAL(a, b)
-#define VKWSI_TEST_UNIQUE_VAR() VKWSI_TEST_CONCAT(vkwsi_var_, __COUNTER__)
-
-#define defer Defer VKWSI_TEST_UNIQUE_VAR() = [&]
-
-#define VT_color_begin(color) "\u001B[" #color "m"
-#define VT_color_reset "\u001B[0m"
-#define VT_color(color, text) VT_color_begin(color) text VT_color_reset
-
-template<typename ...Args>
-void log_trace(std::format_string<Args...> fmt, Args&&... args)
-{
-    std::cout << std::format("[" VT_color(90, "TRACE") "] " VT_color(90, "{}") "\n", std::vformat(fmt.get(), std::make_format_args(args...)));
-}
-
-template<typename ...Args>
-void log_debug(std::format_string<Args...> fmt, Args&&... args)
-{
-    std::cout << std::format("[" VT_color(96, "DEBUG") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
-}
-
-template<typename ...Args>
-void log_info(std::format_string<Args...> fmt, Args&&... args)
-{
-    std::cout << std::format(" [" VT_color(94, "INFO") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
-}
-
-template<typename ...Args>
-void log_warn(std::format_string<Args...> fmt, Args&&... args)
-{
-    std::cout << std::format(" [" VT_color(93, "WARN") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
-}
-
-template<typename ...Args>
-void log_error(std::format_string<Args...> fmt, Args&&... args)
-{
-    std::cout << std::format("[" VT_color(91, "ERROR") "] {}\n", std::vformat(fmt.get(), std::make_format_args(args...)));
-}
-
-// -----------------------------------------------------------------------------
-
-template<typename... Args>
-[[noreturn]] void error(std::source_location loc, std::format_string<Args...> fmt, Args&& ...args)
-{
-    log_error("{}:{} :: {}", loc.file_name(), loc.line(), std::vformat(fmt.get(), std::make_format_args(args...)));
-    std::exit(1);
-}
-
-// -----------------------------------------------------------------------------
-
-struct LocatedVkResult
-{
-    VkResult res;
-    std::source_location loc;
-
-    LocatedVkResult(VkResult _res, std::source_location _loc = std::source_location::current())
-        : res(_res), loc(_loc)
-    {}
-};
-
-VkResult vk_check(LocatedVkResult located_res, auto... allowed)
-{
-    auto[res, loc] = located_res;
-    if (res == VK_SUCCESS || (... || (res == allowed))) return res;
-    error(loc, "VkResult = {}", int(res));
-}
-
-template<typename Container, typename Fn, typename... Args>
-void vk_enumerate(Container& container, Fn&& fn, Args&&... args)
-{
-    uint32_t count = static_cast<uint32_t>(container.size());
-    for (;;) {
-        uint32_t old_count = count;
-        if constexpr (std::same_as<VkResult, decltype(fn(args..., &count, nullptr))>) {
-            vk_check(fn(args..., &count, container.data()), VK_INCOMPLETE);
-        } else {
-            fn(args..., &count, container.data());
-        }
-
-        container.resize(count);
-        if (count <= old_count) return;
-    }
-}
-
-auto ptr_to(auto&& v) { return &v; }
-
-#define vk_instance_fn(fn) PFN_##fn fn = reinterpret_cast<PFN_##fn>(vkGetInstanceProcAddr(instance, #fn)); \
-    if (!fn) error(std::source_location::current(), "Instance function " #fn " failed to load!")
-
-#define vk_device_fn(fn) PFN_##fn fn = reinterpret_cast<PFN_##fn>(vkGetDeviceProcAddr(device, #fn)); \
-    if (!fn) error(std::source_location::current(), "Device function " #fn " failed to load!")
-
-// -----------------------------------------------------------------------------
-
 int main()
 {
     // Options
 
     static constexpr uint32_t num_windows = 1;
     static constexpr uint32_t frames_in_flight = 3;
+    static constexpr uint32_t max_queued_frames = 2;
     static constexpr VkExtent2D initial_window_size = { 800, 600 };
 
 // -----------------------------------------------------------------------------
@@ -402,6 +295,8 @@ int main()
         .device = device,
         .physical_device = physical_device,
         .get_instance_proc_addr = vkGetInstanceProcAddr,
+        .enabled_device_extensions = device_extensions,
+        .enabled_device_extension_count = uint32_t(std::size(device_extensions)),
         .log_callback = {
             .fn = [](void*, vkwsi_log_level level, const char* message) {
                 switch (level) {
@@ -428,8 +323,6 @@ int main()
         VkSurfaceKHR surface;
         vkwsi_swapchain* swapchain;
         bool close_requested = false;
-        std::atomic<VkExtent2D> extent;
-        VkExtent2D last_requested_extent;
     };
 
     std::mutex windows_mutex;
@@ -482,6 +375,8 @@ int main()
         sw_info.queue_families = &queue_family;
         sw_info.queue_family_count = 1;
         sw_info.image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        sw_info.acquire_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        sw_info.present_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 
         VkPresentModeKHR present_modes[] {
             VK_PRESENT_MODE_MAILBOX_KHR,
@@ -490,7 +385,7 @@ int main()
         sw_info.present_mode = vkwsi_context_pick_present_mode(context, wd.surface, present_modes, std::size(present_modes));
 
         switch (sw_info.present_mode) {
-            break;case VK_PRESENT_MODE_MAILBOX_KHR: sw_info.min_image_count = 4;
+            break;case VK_PRESENT_MODE_MAILBOX_KHR: sw_info.min_image_count = 3; sw_info.adaptive_image_count = true;
             break;case VK_PRESENT_MODE_FIFO_KHR:    sw_info.min_image_count = 2;
             break;default:                          ;
         }
@@ -510,7 +405,6 @@ int main()
             glfwGetFramebufferSize(wd.window, &w, &h);
 #endif
             VkExtent2D extent { uint32_t(w), uint32_t(h) };
-            wd.extent = extent;
 
             log_info("window[{}] initial size ({}, {})", i, w, h);
 
@@ -525,10 +419,6 @@ int main()
     uint32_t fps = 0;
 #endif
 
-#if VKWSI_TEST_USE_SDL
-    auto sdl_recheck_size_event = SDL_RegisterEvents(1);
-#endif
-
 #if VKWSI_TEST_USE_GLFW
     std::vector<GLFWwindow*> glfw_window_close_list;
 #endif
@@ -556,16 +446,8 @@ int main()
         }
 #endif
 
-        // Update window swapchain sizes
-        //
-        // NOTE: We do not need to lock `windows_mutex` when iterating over windows if
-        //       we do not invalidate iterators or attempt to read `close_requested`
-
-        for (auto& wd : windows) {
-            wd->last_requested_extent = wd->extent;
-
-            vk_check(vkwsi_swapchain_resize(wd->swapchain, wd->last_requested_extent));
-        }
+        // NOTE: Window sizes are passed to `vkwsi_swapchain_resize` directly from the main thread,
+        //       the next acquire picks up the latest size for each swapchain.
 
         // Handle window destruction
 
@@ -602,6 +484,12 @@ int main()
             if (windows.empty()) return false;
         }
 
+        // Limit presentation latency before doing any work that depends on input
+
+        for (auto& wd : windows) {
+            vk_check(vkwsi_swapchain_wait_for_latency(wd->swapchain, max_queued_frames));
+        }
+
         // Acquire swapchain images
 
         VkSemaphoreSubmitInfoKHR image_ready {
@@ -613,7 +501,21 @@ int main()
 
         std::vector<vkwsi_swapchain*> swapchains;
         for (auto& wd : windows) swapchains.emplace_back(wd->swapchain);
-        vk_check(vkwsi_swapchain_acquire(swapchains.data(), swapchains.size(), queue, &image_ready, 1));
+        // VK_TIMEOUT: one or more swapchains are parked (e.g. minimized) and have no image this frame
+        auto acquire_res = vk_check(vkwsi_swapchain_acquire(swapchains.data(), swapchains.size(), queue, &image_ready, 1), VK_TIMEOUT);
+
+        if (acquire_res == VK_TIMEOUT) {
+            // Acquire doesn't block for parked swapchains, back off until the earliest retry if there is nothing to render
+            bool any_acquired = false;
+            uint64_t retry_ns = UINT64_MAX;
+            for (auto& wd : windows) {
+                any_acquired |= bool(vkwsi_swapchain_get_current(wd->swapchain).image);
+                if (auto t = vkwsi_swapchain_get_park_retry_time(wd->swapchain)) retry_ns = std::min(retry_ns, t);
+            }
+            if (!any_acquired && retry_ns != UINT64_MAX) {
+                std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(retry_ns)));
+            }
+        }
 
 #if VKWSI_TEST_FORCE_LINEARIZATION
         wait_semaphore(semaphore, image_ready.value);
@@ -628,79 +530,17 @@ int main()
         for (auto& wd : windows) {
             auto current = vkwsi_swapchain_get_current(wd->swapchain);
             auto image = current.image;
-
-            {
-                // If the actual swapchain size doesn't match expected, recheck swapchain size on main thread
-                VkExtent2D expected = wd->last_requested_extent;
-                if (expected.width != current.extent.width || expected.height != current.extent.height) {
-#if VKWSI_TEST_USE_SDL
-                    log_warn("Expected size mismatch, requesting SDL thread check window size");
-                    SDL_Event event {
-                        .user = {
-                            .type = SDL_EVENT_USER,
-                            .code = Sint32(sdl_recheck_size_event),
-                            .data1 = wd->window,
-                        },
-                    };
-                    SDL_PushEvent(&event);
-#endif
-#if VKWSI_TEST_USE_GLFW
-                    log_warn("Expected swapchain image size mismatch");
-#endif
-                }
-            }
-
-            auto transition = [&](VkCommandBuffer cmd, VkImage image,
-                VkPipelineStageFlags2 src, VkPipelineStageFlags2 dst,
-                VkAccessFlags2 src_access, VkAccessFlags2 dst_access,
-                VkImageLayout old_layout, VkImageLayout new_layout)
-            {
-                vkCmdPipelineBarrier2(cmd, ptr_to(VkDependencyInfo {
-                    .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-                    .imageMemoryBarrierCount = 1,
-                    .pImageMemoryBarriers = ptr_to(VkImageMemoryBarrier2 {
-                        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                        .srcStageMask = src,
-                        .srcAccessMask = src_access,
-                        .dstStageMask = dst,
-                        .dstAccessMask = dst_access,
-                        .oldLayout = old_layout,
-                        .newLayout = new_layout,
-                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .image = image,
-                        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
-                    }),
-                }));
-            };
+            if (!image) continue;
 
             // TODO: Update to latest git version of VVL and aim for zero synchronization validation warnings
             //       Need to check on status of synchronization layers when using timeline semaphores!
 
-            // transition(cmd, image,
-            //     VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            //     0, VK_ACCESS_2_TRANSFER_WRITE_BIT,
-            //     VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-            transition(cmd, image,
-                VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-                VK_ACCESS_2_MEMORY_WRITE_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT,
-                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            // NOTE: The library transitions the image to TRANSFER_DST_OPTIMAL on acquire and back to PRESENT_SRC_KHR on present
 
             vkCmdClearColorImage(cmd, image,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 ptr_to(get_clear_color()),
                 1, ptr_to(VkImageSubresourceRange { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }));
-
-            // transition(cmd, image,
-            //     VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
-            //     VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
-            //     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-
-            transition(cmd, image,
-                VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-                VK_ACCESS_2_MEMORY_WRITE_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
         }
 
         vk_check(vkEndCommandBuffer(cmd));
@@ -756,7 +596,7 @@ int main()
         for (auto& wd : windows) {
             if (wd->window == window) {
                 log_trace("Window {} resized ({}, {})", (void*)wd->window, w, h);
-                wd->extent = { uint32_t(w), uint32_t(h) };
+                vk_check(vkwsi_swapchain_resize(wd->swapchain, { uint32_t(w), uint32_t(h) }));
                 break;
             }
         }
@@ -792,14 +632,6 @@ int main()
                 }
             }
         }
-        else if (event.type == SDL_EVENT_USER) {
-            if (event.user.code == sdl_recheck_size_event) {
-                auto window = static_cast<SDL_Window*>(event.user.data1);
-                int w, h;
-                SDL_GetWindowSizeInPixels(window, &w, &h);
-                on_window_resize(window, w, h);
-            }
-        }
     }
 
     {